@@ -0,0 +1,442 @@
+// lx_bench - logging, formatting & timestamp micro-benchmarks, results as CSV or JSON
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+
+#include "lx/ulog.h"
+
+using namespace std;
+using namespace LX;
+
+#ifdef WIN32
+	#define	NULL_DEVICE	"NUL"
+#else
+	#define	NULL_DEVICE	"/dev/null"
+#endif
+
+struct bench_result
+{
+	string		m_Group;
+	string		m_Case;
+	size_t		m_Threads;
+	uint64_t	m_Ops;
+	double		m_NsPerOp;
+};
+
+static vector<bench_result>	s_Results;
+static atomic<uint64_t>		s_Sink{0};		// keeps results observable
+
+//---- Null Log Slot ----------------------------------------------------------
+
+	// dispatch cost only, may be called concurrently
+
+class NullLog : public LogSlot
+{
+public:
+	void	LogAtLevel(const timestamp_t, const LogLevel, const string&, const size_t) override
+	{
+	}
+	
+	// deferred records aren't rendered
+	void	LogRecordAtLevel(const LogRecord&) override
+	{
+	}
+};
+
+//---- timing -----------------------------------------------------------------
+
+static
+double	ElapsedNs(const chrono::steady_clock::time_point &t0)
+{
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - t0).count();
+}
+
+static
+void	AddResult(const string &group, const string &case_s, const size_t n_threads, const uint64_t ops, const double ns)
+{
+	s_Results.push_back({group, case_s, n_threads, ops, ops ? (ns / ops) : 0.0});
+	
+	::fprintf(stderr, "  %-10s %-28s x%-3zu %10.1f ns/op\n", group.c_str(), case_s.c_str(), n_threads, s_Results.back().m_NsPerOp);
+}
+
+// single-threaded, with 1/10th warm-up
+static
+void	Run(const string &group, const string &case_s, const uint64_t n, const function<void(uint64_t)> &fn)
+{
+	for (uint64_t i = 0; i < (n / 10); i++)		fn(i);
+	
+	const auto	t0 = chrono::steady_clock::now();
+	
+	for (uint64_t i = 0; i < n; i++)		fn(i);
+	
+	AddResult(group, case_s, 1, n, ElapsedNs(t0));
+}
+
+//---- uLog latency -----------------------------------------------------------
+
+static
+void	BenchULog(rootLog &root, const uint64_t n, const string &tmp_dir)
+{
+	const string	str("some string");
+	
+	auto	ulog_fn = [&](uint64_t i)
+	{
+		uLog(LX_MSG, "i = %d, s = %S, f = %.3f", i, str, i * 0.5);
+	};
+	
+	// static call site (cached enable state)
+	auto	site_fn = [&](uint64_t i)
+	{
+		LX_LOG(LX_MSG, "i = %d, s = %S, f = %.3f", i, str, i * 0.5);
+	};
+	
+	// compile-time format (static, so deferrable)
+	auto	fmt_fn = [&](uint64_t i)
+	{
+		uLog(LX_MSG, "i = %d, s = %S, f = %.3f"_fmt, i, str, i * 0.5);
+	};
+	
+	root.ClearAllLevels();
+	Run("ulog", "disabled", n, ulog_fn);
+	Run("ulog", "disabled_site", n, site_fn);
+	
+	root.EnableLevels({LX_MSG});
+	Run("ulog", "enabled_no_slot", n, ulog_fn);
+	
+	{	NullLog	null_slot;
+	
+		root.Connect(&null_slot);
+		Run("ulog", "null_slot", n, ulog_fn);
+		Run("ulog", "null_slot_site", n, site_fn);
+		
+		Run("ulog", "null_slot_fmt", n, fmt_fn);
+		
+		root.SetDeferredFormat(true);
+		Run("ulog", "null_slot_deferred", n, fmt_fn);
+		root.SetDeferredFormat(false);
+		
+		root.Disconnect(&null_slot);
+	}
+	
+	const string	fn = tmp_dir + "/lx_bench.log";
+	
+	{	unique_ptr<LogSlot>	file_slot(LogSlot::Create(LOG_TYPE_T::STD_FILE, fn));
+	
+		root.Connect(file_slot.get());
+		Run("ulog", "file_slot", n, ulog_fn);
+		root.Disconnect(file_slot.get());
+	}
+	
+	{	unique_ptr<LogSlot>	buff_slot(LogSlot::CreateBuffered(fn));
+	
+		root.Connect(buff_slot.get());
+		Run("ulog", "buffered_file_slot", n, ulog_fn);
+		root.Disconnect(buff_slot.get());
+	}
+	
+	::remove(fn.c_str());
+	
+	{	// measures the stream path, not the terminal
+		filebuf	null_buf;
+		
+		null_buf.open(NULL_DEVICE, ios_base::out);
+		
+		streambuf	*org_buf = cout.rdbuf(&null_buf);
+		
+		unique_ptr<LogSlot>	cout_slot(LogSlot::Create(LOG_TYPE_T::STD_COUT, ""));
+		
+		root.Connect(cout_slot.get());
+		Run("ulog", "cout_slot", n, ulog_fn);
+		root.Disconnect(cout_slot.get());
+		
+		cout.flush();
+		cout.rdbuf(org_buf);
+	}
+	
+	root.ClearAllLevels();
+}
+
+//---- xsprintf vs snprintf ---------------------------------------------------
+
+static
+void	BenchFormat(const uint64_t n)
+{
+	const string	str("some string");
+	char		buff[256];
+	
+	Run("format", "xsprintf_int", n, [&](uint64_t i)
+	{
+		s_Sink += xsprintf("%d", (int) i).size();
+	});
+	
+	Run("format", "snprintf_int", n, [&](uint64_t i)
+	{
+		s_Sink += ::snprintf(buff, sizeof(buff), "%d", (int) i);
+	});
+	
+	Run("format", "xsprintf_str", n, [&](uint64_t i)
+	{
+		s_Sink += xsprintf("name = %s, len = %zu", str, (size_t) i).size();
+	});
+	
+	Run("format", "snprintf_str", n, [&](uint64_t i)
+	{
+		s_Sink += ::snprintf(buff, sizeof(buff), "name = %s, len = %zu", str.c_str(), (size_t) i);
+	});
+	
+	Run("format", "xsprintf_float", n, [&](uint64_t i)
+	{
+		s_Sink += xsprintf("%.3f %g", i * 0.25, i * 1.5).size();
+	});
+	
+	Run("format", "snprintf_float", n, [&](uint64_t i)
+	{
+		s_Sink += ::snprintf(buff, sizeof(buff), "%.3f %g", i * 0.25, i * 1.5);
+	});
+	
+	Run("format", "xsprintf_mixed", n, [&](uint64_t i)
+	{
+		s_Sink += xsprintf("%5d|%08x|%s|%c|%.2f|%p", (int) i, (unsigned) i, str, 'c', i * 0.5, (const void*) &str).size();
+	});
+	
+	Run("format", "xsprintf_fmt_mixed", n, [&](uint64_t i)
+	{
+		s_Sink += xsprintf("%5d|%08x|%s|%c|%.2f|%p"_fmt, (int) i, (unsigned) i, str, 'c', i * 0.5, (const void*) &str).size();
+	});
+	
+	Run("format", "snprintf_mixed", n, [&](uint64_t i)
+	{
+		s_Sink += ::snprintf(buff, sizeof(buff), "%5d|%08x|%s|%c|%.2f|%p", (int) i, (unsigned) i, str.c_str(), 'c', i * 0.5, (const void*) &str);
+	});
+	
+	Run("format", "xargs_pack_render", n, [&](uint64_t i)
+	{
+		xargs	xa;
+		
+		xa.Pack((int) i, str, i * 0.5);
+		
+		s_Sink += xa.Render("%d %s %.2f").size();
+	});
+}
+
+//---- timestamp strings ------------------------------------------------------
+
+static
+void	BenchStamp(const uint64_t n)
+{
+	const struct
+	{
+		const char	*m_Name;
+		STAMP_FORMAT	m_Fmt;
+	} formats[] =
+	{
+		{"second",		STAMP_FORMAT::SECOND},
+		{"millisec",		STAMP_FORMAT::MILLISEC},
+		{"microsec",		STAMP_FORMAT::MICROSEC},
+		{"millisec_utc",	STAMP_FORMAT::MILLISEC | STAMP_FORMAT::UTC},
+		{"ymd_microsec",	STAMP_FORMAT::YMD | STAMP_FORMAT::MICROSEC},
+	};
+	
+	const timestamp_t	base = timestamp_t::Now();
+	
+	for (const auto &f : formats)
+	{
+		const STAMP_FORMAT	fmt = f.m_Fmt;
+		
+		Run("stamp", f.m_Name, n, [&](uint64_t i)
+		{
+			s_Sink += base.OffsetMilliSecs(i).str(fmt).size();
+		});
+	}
+	
+	const struct
+	{
+		const char	*m_Name;
+		STAMP_CLOCK	m_Clock;
+	} clocks[] =
+	{
+		{"now_system",		STAMP_CLOCK::SYSTEM},
+		{"now_coarse",		STAMP_CLOCK::REALTIME_COARSE},
+		{"now_tsc",		STAMP_CLOCK::TSC},
+		{"now_monotonic",	STAMP_CLOCK::MONOTONIC},
+	};
+	
+	for (const auto &c : clocks)
+	{
+		if (!timestamp_t::SetClock(c.m_Clock))	continue;		// (unavailable here)
+		
+		Run("stamp", c.m_Name, n, [&](uint64_t)
+		{
+			s_Sink += timestamp_t::Now().GetUSecs();
+		});
+	}
+	
+	timestamp_t::SetClock(STAMP_CLOCK::SYSTEM);
+}
+
+//---- multi-producer scaling -------------------------------------------------
+
+static
+void	BenchScaling(const uint64_t n, const size_t max_threads, const string &tmp_dir)
+{
+	const string	fn = tmp_dir + "/lx_bench_mt.log";
+	const string	msg("a typical log message of some length, around 64 chars or so");
+	
+	// 1, 2, 4... max
+	vector<size_t>	thread_counts;
+	
+	for (size_t n_threads = 1; n_threads < max_threads; n_threads *= 2)	thread_counts.push_back(n_threads);
+	
+	thread_counts.push_back(max_threads);
+	
+	for (int pass = 0; pass < 2; pass++)
+	{
+		LogSignal		sig;
+		NullLog			null_slot;
+		unique_ptr<LogSlot>	buff_slot;
+		
+		if (0 == pass)
+			sig.Connect(&null_slot);
+		else
+		{	buff_slot.reset(LogSlot::CreateBuffered(fn));
+			sig.Connect(buff_slot.get());
+		}
+		
+		const char	*case_s = (0 == pass) ? "emit_null_slot" : "emit_buffered_slot";
+		
+		for (const size_t n_threads : thread_counts)
+		{
+			const uint64_t	per_thread = n / n_threads;
+			atomic<size_t>	ready{0};
+			atomic<bool>	go{false};
+			
+			auto	worker = [&]()
+			{
+				const size_t	thread_index = LogSignal::GetThreadIndex();
+				
+				ready++;
+				while (!go)	this_thread::yield();
+				
+				for (uint64_t i = 0; i < per_thread; i++)
+					sig.EmitAll(timestamp_t::Now(), LX_MSG, msg, thread_index);
+			};
+			
+			vector<thread>	threads;
+			
+			for (size_t t = 0; t < n_threads; t++)	threads.emplace_back(worker);
+			
+			while (ready < n_threads)	this_thread::yield();
+			
+			const auto	t0 = chrono::steady_clock::now();
+			
+			go = true;
+			
+			for (auto &th : threads)	th.join();
+			
+			// aggregate throughput, i.e. ns per message across all producers
+			AddResult("scaling", case_s, n_threads, per_thread * n_threads, ElapsedNs(t0));
+		}
+		
+		if (buff_slot)	sig.Disconnect(buff_slot.get());
+	}
+	
+	::remove(fn.c_str());
+}
+
+//---- output -----------------------------------------------------------------
+
+static
+void	WriteCSV(FILE *f)
+{
+	::fprintf(f, "group,case,threads,ops,ns_per_op,mops_per_sec\n");
+	
+	for (const auto &r : s_Results)
+		::fprintf(f, "%s,%s,%zu,%llu,%.2f,%.3f\n", r.m_Group.c_str(), r.m_Case.c_str(), r.m_Threads, (unsigned long long) r.m_Ops, r.m_NsPerOp, (r.m_NsPerOp > 0) ? (1000.0 / r.m_NsPerOp) : 0.0);
+}
+
+static
+void	WriteJSON(FILE *f)
+{
+	::fprintf(f, "{\n  \"stamp\": \"%s\",\n  \"results\": [\n", timestamp_t::Now().str(STAMP_FORMAT::SECOND | STAMP_FORMAT::UTC).c_str());
+	
+	for (size_t i = 0; i < s_Results.size(); i++)
+	{
+		const bench_result	&r = s_Results[i];
+		
+		::fprintf(f, "    {\"group\": \"%s\", \"case\": \"%s\", \"threads\": %zu, \"ops\": %llu, \"ns_per_op\": %.2f}%s\n",
+			r.m_Group.c_str(), r.m_Case.c_str(), r.m_Threads, (unsigned long long) r.m_Ops, r.m_NsPerOp, ((i + 1) < s_Results.size()) ? "," : "");
+	}
+	
+	::fprintf(f, "  ]\n}\n");
+}
+
+static
+void	Usage(void)
+{
+	::fprintf(stderr,
+		"usage: lx_bench [options]\n"
+		"  -n <ops>       ops per case (default 1000000)\n"
+		"  -t <threads>   max producer threads (default: all cores)\n"
+		"  -d <dir>       dir for temporary log files (default .)\n"
+		"  -j             JSON output (default CSV)\n"
+		"  -o <file>      output file (default stdout)\n"
+		"  -g <group>     only run group (ulog, format, stamp, scaling)\n");
+}
+
+int	main(int argc, char *argv[])
+{
+	uint64_t	n = 1000000;
+	size_t		max_threads = std::max(1u, thread::hardware_concurrency());
+	string		tmp_dir("."), out_fn, group;
+	bool		json_f = false;
+	
+	for (int i = 1; i < argc; i++)
+	{
+		const string	arg(argv[i]);
+		
+		if (("-n" == arg) && ((i + 1) < argc))		n = std::max(1, Soft_stoi(argv[++i], 1));
+		else if (("-t" == arg) && ((i + 1) < argc))	max_threads = std::max(1, Soft_stoi(argv[++i], 1));
+		else if (("-d" == arg) && ((i + 1) < argc))	tmp_dir = argv[++i];
+		else if (("-o" == arg) && ((i + 1) < argc))	out_fn = argv[++i];
+		else if (("-g" == arg) && ((i + 1) < argc))	group = argv[++i];
+		else if ("-j" == arg)				json_f = true;
+		else
+		{	Usage();
+			return 1;
+		}
+	}
+	
+	rootLog	root;
+	
+	if (group.empty() || ("ulog" == group))		BenchULog(root, n, tmp_dir);
+	if (group.empty() || ("format" == group))	BenchFormat(n);
+	if (group.empty() || ("stamp" == group))	BenchStamp(n);
+	if (group.empty() || ("scaling" == group))	BenchScaling(n, max_threads, tmp_dir);
+	
+	FILE	*f = out_fn.empty() ? stdout : ::fopen(out_fn.c_str(), "w");
+	
+	if (!f)
+	{
+		::fprintf(stderr, "lx_bench: can't open %s\n", out_fn.c_str());
+		return 1;
+	}
+	
+	if (json_f)	WriteJSON(f);
+	else		WriteCSV(f);
+	
+	if (f != stdout)	::fclose(f);
+	
+	return (s_Sink == 0xdeadbeef) ? 2 : 0;		// (never)
+}
+
+// nada mas
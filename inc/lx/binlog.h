@@ -0,0 +1,74 @@
+// lx utils binary log format
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "lx/xutils.h"
+
+namespace LX
+{
+
+/*
+
+on-disk layout, all integers little-endian, raw args are the host's xargs bytes
+
+	file header	"LXBLOG1\0", u32 version, u32 flags, i64 open stamp (usecs)
+	blocks		"LXBK", u32 dict bytes, u32 record bytes, u32 record count, i64 base stamp (usecs)
+	  dictionary	[varint id, varint len, format chars]		formats first used in this block
+	  records	[zigzag varint stamp delta, u32 level, varint thread index, varint format id, varint len, bytes]
+
+format id 0 means bytes are the already rendered message, else packed xargs
+stamp deltas chain from the block's base stamp, so blocks decode independently once the dictionary is known
+
+*/
+
+constexpr char		BINLOG_MAGIC[8] = {'L', 'X', 'B', 'L', 'O', 'G', '1', '\0'};
+constexpr char		BINLOG_BLOCK_MAGIC[4] = {'L', 'X', 'B', 'K'};
+constexpr uint32_t	BINLOG_VERSION = 1;
+constexpr size_t	BINLOG_HEADER_SIZE = 24;
+constexpr size_t	BINLOG_BLOCK_HEADER_SIZE = 24;
+
+struct binlog_block
+{
+	uint64_t	m_Offset;		// of record bytes
+	uint32_t	m_RecBytes;
+	uint32_t	m_Count;
+	int64_t		m_BaseUS;
+};
+
+//---- Binary Log Reader ------------------------------------------------------
+
+class BinLogReader
+{
+public:
+	explicit BinLogReader(const std::string &fn);
+	
+	// reads header, block headers & dictionary (record bytes are skipped)
+	bool	Scan(void);
+	
+	const std::vector<binlog_block>&	Blocks(void) const	{return m_Blocks;}
+	const std::string&			Error(void) const	{return m_Error;}
+	
+	// sequential, NOT thread-safe
+	bool	ReadBlock(const binlog_block &blk, std::string &bytes);
+	
+	// to text file layout, thread-safe
+	bool	RenderBlock(const binlog_block &blk, const std::string &bytes, const STAMP_FORMAT fmt, const double min_elap_secs, std::string &out) const;
+
+private:
+
+	bool	Fail(const std::string &err);
+	
+	std::ifstream			m_IFS;
+	std::vector<std::string>	m_Formats;		// by id (0 unused)
+	std::vector<binlog_block>	m_Blocks;
+	std::string			m_Error;
+};
+
+} // namespace LX
+
+// nada mas
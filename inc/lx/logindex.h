@@ -0,0 +1,129 @@
+// lx utils sidecar time/level index for text log files
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include "lx/xutils.h"
+
+namespace LX
+{
+
+/*
+
+sidecar "<fn>.lxi" next to an indexed text log (LogSlot::CreateIndexed), all integers little-endian
+
+	header		"LXIDX1\0\0", u32 version, u32 stamp format, u32 block bytes, u32 reserved
+	entries		u64 offset, u32 bytes, u32 lines, i64 min stamp, i64 max stamp (usecs), u64 level bits[4]
+
+one entry per block of ~<block bytes> of whole lines, appended once the block has hit the log file,
+so the index is at most one block (plus whatever was pending at a crash) behind the log: readers scan that tail
+level bits are a 256-bit bloom of the level hashes seen in the block (one bit per level, see logindex_level_bit)
+
+*/
+
+constexpr char		LOGINDEX_MAGIC[8] = {'L', 'X', 'I', 'D', 'X', '1', '\0', '\0'};
+constexpr uint32_t	LOGINDEX_VERSION = 1;
+constexpr size_t	LOGINDEX_HEADER_SIZE = 24;
+constexpr size_t	LOGINDEX_ENTRY_SIZE = 64;
+
+constexpr
+unsigned	logindex_level_bit(const uint32_t level)
+{
+	// (djb2 low bits are poorly mixed)
+	return (uint32_t) (level * 0x9e3779b1u) >> 24;
+}
+
+struct logindex_block
+{
+	uint64_t	m_Offset;
+	uint32_t	m_Bytes;
+	uint32_t	m_Lines;
+	int64_t		m_MinUS;
+	int64_t		m_MaxUS;
+	uint64_t	m_LevelBits[4];
+	
+	void	AddLevel(const uint32_t level)			{m_LevelBits[logindex_level_bit(level) / 64] |= 1ull << (logindex_level_bit(level) % 64);}
+	bool	HasAnyLevel(const uint64_t (&bits)[4]) const	{return (m_LevelBits[0] & bits[0]) | (m_LevelBits[1] & bits[1]) | (m_LevelBits[2] & bits[2]) | (m_LevelBits[3] & bits[3]);}
+};
+
+//---- Log Index Writer -------------------------------------------------------
+
+	// fed every line in file order (caller serializes), closed blocks are handed out as entry bytes
+	// for the caller to write AFTER the lines themselves
+
+class LogIndexWriter
+{
+public:
+	LogIndexWriter(const std::string &log_fn, const STAMP_FORMAT fmt, const size_t block_bytes);
+	~LogIndexWriter();
+	
+	static std::string	IndexName(const std::string &log_fn)	{return log_fn + ".lxi";}
+	
+	bool	IsOpen(void) const		{return m_File != nil;}
+	
+	void	AddLine(const size_t n, const int64_t us, const uint32_t level);
+	
+	// closes the current block even if short (clean shutdown)
+	void	CloseBlock(void);
+	
+	// moves closed entries out (may be empty)
+	void	TakeEntries(std::string &entries)	{entries.swap(m_Entries); m_Entries.clear();}
+	
+	// (caller holds whatever serializes the log's file writes)
+	void	WriteEntries(const std::string &entries);
+
+private:
+
+	const size_t	m_BlockBytes;
+	FILE		*m_File;
+	uint64_t	m_Offset;		// of current block
+	logindex_block	m_Block;
+	std::string	m_Entries;		// closed, not yet written
+};
+
+//---- Log Index Reader -------------------------------------------------------
+
+	// candidate blocks for a time range & level set, in O(log blocks + candidates) for time ranges
+	// (level-only queries test every entry's bits, still ~1/1000th of the log's size)
+
+class LogIndexReader
+{
+public:
+	explicit LogIndexReader(const std::string &log_fn);
+	
+	// reads header & entries, validates them against the log's size, appends the unindexed tail as a wildcard block
+	bool	Load(void);
+	
+	STAMP_FORMAT	Format(void) const			{return m_Fmt;}
+	const std::vector<logindex_block>&	Blocks(void) const	{return m_Blocks;}
+	size_t		IndexedBlocks(void) const		{return m_Indexed;}		// (rest are the unindexed tail)
+	const std::string&	Error(void) const		{return m_Error;}
+	
+	// levels empty = any level
+	void	Query(const int64_t from_us, const int64_t to_us, const std::vector<uint32_t> &levels, std::vector<logindex_block> &res) const;
+	
+	// sequential, NOT thread-safe
+	bool	ReadBlock(const logindex_block &blk, std::string &bytes);
+
+private:
+
+	bool	Fail(const std::string &err);
+	
+	const std::string		m_LogName;
+	std::ifstream			m_IFS;
+	STAMP_FORMAT			m_Fmt;
+	std::vector<logindex_block>	m_Blocks;
+	size_t				m_Indexed;
+	std::vector<int64_t>		m_MaxPrefix;		// running max of m_MaxUS (binary-searchable)
+	std::vector<int64_t>		m_MinSuffix;		// running min of m_MinUS from the end (stop test)
+	std::string			m_Error;
+};
+
+} // namespace LX
+
+// nada mas
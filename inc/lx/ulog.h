@@ -10,6 +10,8 @@
 #include <stdexcept>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <memory>
 
 #include "lx/xutils.h"
 #include "lx/xstring.h"
@@ -18,6 +20,11 @@
 namespace LX
 {
 class LogSignal;
+class AsyncLog;
+class LevelTable;
+class SlotTable;
+class SlotMasks;
+struct LogSite;
 
 using std::string;
 using std::vector;
@@ -25,6 +32,9 @@ using std::unordered_set;
 using std::unordered_map;
 using std::thread;
 using std::mutex;
+using std::unique_lock;
+using std::atomic;
+using std::unique_ptr;
 
 using LOG_HASH_T = uint32_t;			// 32-bit is enough?
 
@@ -43,10 +53,164 @@ LOG_HASH_T operator "" _log(const char *s, size_t n)
 
 using LogLevel = LOG_HASH_T;
 
+//---- Dense Level IDs --------------------------------------------------------
+
+	// process-wide map of (sparse) tag hashes to small dense ids, so level filters & per-level tables
+	// are bitsets / arrays indexed by id instead of hash sets; ids are handed out on first use (enabling,
+	// subscribing or limiting a tag) or when registering its name, which catches two tags hashing alike
+	// lookups are lock-free and usable during static init, id 0 = LOG_NIL / never registered / table full
+
+using LogLevelID = uint16_t;
+
+constexpr size_t	LOG_LEVEL_ID_MAX = 1024;
+
+LogLevelID	log_level_id(const LogLevel lvl);		// registers on first use
+LogLevelID	log_level_find(const LogLevel lvl);		// (never registers)
+LogLevelID	log_level_register(const char *name);		// 0 if a DIFFERENT name has the same hash
+const char*	log_level_name(const LogLevel lvl);		// nil if only registered by hash
+
+class LogLevelBits
+{
+public:
+	LogLevelBits()
+		: m_Bits{}
+	{
+	}
+	
+	void	Set(const LogLevelID id)		{m_Bits[id / 64] |= (1ull << (id % 64));}
+	void	Reset(const LogLevelID id)		{m_Bits[id / 64] &= ~(1ull << (id % 64));}
+	bool	Test(const LogLevelID id) const		{return (m_Bits[id / 64] >> (id % 64)) & 1;}
+	
+	bool	operator==(const LogLevelBits &o) const
+	{
+		for (size_t i = 0; i < (LOG_LEVEL_ID_MAX / 64); i++)
+			if (m_Bits[i] != o.m_Bits[i])	return false;
+		
+		return true;
+	}
+
+private:
+
+	uint64_t	m_Bits[LOG_LEVEL_ID_MAX / 64];
+};
+
 enum class LOG_TYPE_T : int
 {
 	STD_FILE = 1,
 	STD_COUT,
+	BUFFERED_FILE,			// (default flush policy)
+	MMAP_FILE,			// (default segment size)
+	BINARY_FILE,			// (see lxlogdump)
+	JSON_FILE,			// JSON lines (default flush policy)
+};
+
+// when a buffered file slot hits the disk (besides when its buffer is full)
+enum class FLUSH_POLICY : int
+{
+	LINE = 1,		// every line
+	INTERVAL,		// every N millisecs
+	ERRORS,			// on FATAL / EXCEPTION / LX_ERROR lines only
+};
+
+// what async producers do when the queue is full
+enum class LOG_OVERFLOW_T : int
+{
+	BLOCK = 1,		// yield until consumer frees a cell
+	DROP,			// count & discard, consumer reports the loss
+};
+
+// when a rotating file slot switches to a fresh file, and what it keeps
+struct LogRotation
+{
+	size_t	m_MaxBytes = 64 * 1024 * 1024;	// 0 = no size limit
+	int	m_IntervalSecs = 0;		// 0 = no time limit, else on UTC multiples (86400 = daily)
+	size_t	m_Keep = 8;			// rotated files retained
+	bool	m_Compress = true;		// LZ-compress rotated files on background thread
+};
+
+// sidecar time/level index of a buffered file slot (see logindex.h, lxlogquery)
+struct LogIndexing
+{
+	size_t	m_BlockBytes = 64 * 1024;	// log bytes per index entry
+};
+
+// rate limit and/or sampling for a level or a call site (checked before formatting)
+struct LogLimit
+{
+	double		m_PerSec = 0;			// sustained records/sec, 0 = no rate limit
+	double		m_Burst = 1;			// records allowed back-to-back (token bucket size)
+	uint32_t	m_SampleN = 1;			// then keep 1 in N, 0/1 = keep all
+	double		m_SummarySecs = 10;		// min secs between suppressed-count summaries
+};
+
+//---- Log Record -------------------------------------------------------------
+
+	// one log event as queued in async mode and handed to slots
+	// if deferred, message is rendered from format ptr & packed args on first Msg() call,
+	// i.e. only if some slot needs text
+	// structured records (uLogKV) pack the message & typed (key, value) pairs in m_Args,
+	// their text is "msg key=value ..." (also rendered on demand)
+
+struct LogRecord
+{
+	timestamp_t	m_Stamp;
+	LogLevel	m_Level;
+	size_t		m_ThreadIndex;
+	mutable string	m_Msg;			// (lazily rendered if deferred or structured)
+	const char	*m_Fmt;			// non-nil if deferred
+	xargs		m_Args;
+	const LogSite	*m_Site = nil;		// static call site (LX_LOG), if any
+	bool		m_FieldsFlag = false;	// m_Args is message + (key, value) pairs
+	
+	const string&	Msg(void) const;
+	
+	// text of structured record, or of one " key=value" field (strings quoted)
+	void		RenderFields(xout &out) const;
+	static void	AppendField(xout &out, const xarg_view &key, const xarg_view &val);
+};
+
+//---- Log Site ---------------------------------------------------------------
+
+	// one static descriptor per LX_LOG() statement (constant-initialized, so no guard)
+	// its enabled state is cached along with the generation it was computed at; level,
+	// slot or root changes bump the global generation so each site re-evaluates once
+
+struct LogSite
+{
+	constexpr LogSite(const LogLevel lvl, const char *fmt, const char *file, const int line)
+		: m_Level(lvl), m_Fmt(fmt), m_File(file), m_Line(line), m_State{0}
+	{
+	}
+	
+	template<char ... _Cs>
+	constexpr LogSite(const LogLevel lvl, xfmt<_Cs...> fmt, const char *file, const int line)
+		: m_Level(lvl), m_Fmt(fmt.c_str()), m_File(file), m_Line(line), m_State{0}
+	{
+	}
+	
+	bool	IsEnabled(void) const
+	{
+		const uint32_t	state = m_State.load(std::memory_order_relaxed);
+		
+		if ((state >> 1) == s_Generation.load(std::memory_order_relaxed))	return state & 1;
+		
+		return Refresh();
+	}
+	
+	static void	BumpGeneration(void);
+	
+	const LogLevel		m_Level;
+	const char		*const m_Fmt;
+	const char		*const m_File;
+	const int		m_Line;
+	
+private:
+
+	bool	Refresh(void) const;
+	
+	mutable atomic<uint32_t>	m_State;		// (generation << 1) | enabled, 0 = never evaluated
+	
+	static atomic<uint32_t>		s_Generation;		// (starts at 1)
 };
 
 //---- Log Slot ---------------------------------------------------------------
@@ -59,53 +223,183 @@ public:
 	LogSlot();
 	virtual ~LogSlot();
 
+	// derived slots call it first thing in their dtor, so no emitter (or the async consumer,
+	// or the crash handler) ever calls into a half-destroyed slot
 	void	DisconnectSelf(void);
 
+	// level subscription (all levels by default), other levels are never emitted to this slot
+	void	SubscribeLevels(const unordered_set<LogLevel> &levels);
+	void	SubscribeAllLevels(void);
+	bool	IsSubscribedToAll(void) const				{return m_AllLevelsFlag;}
+	const unordered_set<LogLevel>&	GetSubscribedLevels(void) const	{return m_Levels;}
+
 	virtual void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) = 0;
 	
+	// raw record (deferred format & args), defaults to rendering it for LogAtLevel()
+	virtual void	LogRecordAtLevel(const LogRecord &rec);
+	
+	// from the fatal signal handler only (see rootLog::InstallCrashHandler), so mustn't lock or
+	// allocate: write() out whatever is pending, false if this slot can't write at crash time
+	virtual bool	CrashFlush(void)		{return false;}
+	// then appends queued records & the final marker line
+	virtual void	CrashLog(const timestamp_t, const LogLevel, const char *, const size_t, const size_t)	{}
+	
 	// shouldn't be here? -- should be MEMBER of log SIGNAL?
 	static LogSlot*	Create(const LOG_TYPE_T log_t, const string &fn, const STAMP_FORMAT stamp_fmt = STAMP_FORMAT::MILLISEC, const double min_elap_secs = 3.0);
-	static LogSlot*	CreateDedup(LogSlot &next_slot);
+	static LogSlot*	CreateDedup(LogSlot &next_slot, const int flush_ms = 1000, const size_t window = 256);
+	static LogSlot*	CreateMapped(const string &fn, const size_t segment_size = 16 * 1024 * 1024, const STAMP_FORMAT stamp_fmt = STAMP_FORMAT::MILLISEC, const double min_elap_secs = 3.0, const size_t keep_runs = 2);
+	static LogSlot*	CreateBuffered(const string &fn, const FLUSH_POLICY policy = FLUSH_POLICY::INTERVAL, const int interval_ms = 500, const STAMP_FORMAT stamp_fmt = STAMP_FORMAT::MILLISEC, const double min_elap_secs = 3.0, const size_t buff_size = 256 * 1024);
+	static LogSlot*	CreateBinary(const string &fn, const size_t block_size = 64 * 1024);
+	static LogSlot*	CreateJSON(const string &fn, const FLUSH_POLICY policy = FLUSH_POLICY::INTERVAL, const int interval_ms = 500, const size_t buff_size = 256 * 1024);
+	static LogSlot*	CreateRotating(const string &fn, const LogRotation &rotation = LogRotation{}, const FLUSH_POLICY policy = FLUSH_POLICY::INTERVAL, const int interval_ms = 500, const STAMP_FORMAT stamp_fmt = STAMP_FORMAT::MILLISEC, const double min_elap_secs = 3.0, const size_t buff_size = 256 * 1024);
+	static LogSlot*	CreateIndexed(const string &fn, const LogIndexing &indexing = LogIndexing{}, const FLUSH_POLICY policy = FLUSH_POLICY::INTERVAL, const int interval_ms = 500, const STAMP_FORMAT stamp_fmt = STAMP_FORMAT::MILLISEC, const double min_elap_secs = 3.0, const size_t buff_size = 256 * 1024);
 	static bool	IsLogOp(const LogLevel level);
 
 private:
 
 	// accessed by signal -- shouldn't be here?
 	void	LogAtLevel_LL(const timestamp_t stamp_ms, const LogLevel level, const string &msg, const size_t thread_id);
+	void	LogRecordAtLevel_LL(const LogRecord &rec);
 	void	SetSignal(LogSignal *sig);
 	void	RemoveSignal(void);
 	
-	LogSignal		*m_OrgSignal;
+	atomic<LogSignal*>	m_OrgSignal;		// (read by emitting threads)
+	
+	// (written under signal's slot mutex while connected)
+	bool			m_AllLevelsFlag;
+	unordered_set<LogLevel>	m_Levels;
 	
 	// no class copy
 	LogSlot(const LogSlot &) = delete;
 	LogSlot &operator=(const LogSlot &) = delete;
 };
 
+//---- Log Line ---------------------------------------------------------------
+
+	// text line layout shared by file slots:
+	//   [separator dashes if elapsed > min secs]
+	//   <stamp>[|<hex level>|] [_THREAD <hex index> :] <msg>
+
+class LogLine
+{
+public:
+	static constexpr size_t	CRASH_LINE_MAX = 4096;		// (stack buffer at crash time)
+	
+	LogLine(const STAMP_FORMAT fmt, const double min_elap_secs);
+	
+	// appends line(s) with trailing newline
+	void	Compose(string &s, const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id);
+	
+	// into caller buffer, async-signal-safe (no allocation, lock nor throw; truncated but still
+	// newline-terminated), returns length
+	size_t	CrashCompose(char *buff, const size_t buff_size, const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id);
+	
+	// separator dashes are relative to this
+	void	SetLastStamp(const timestamp_t stamp)		{m_LastStamp = stamp;}
+	
+private:
+	
+	void	Compose(xout &out, const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id, const bool crash_f);
+	
+	const STAMP_FORMAT	m_Fmt;
+	const double		m_MinSepElapSecs;
+	const bool		m_HexLevelFlag;
+	timestamp_t		m_LastStamp;
+};
+
+//---- Log Limiter ------------------------------------------------------------
+
+	// lock-free token bucket (as GCRA, i.e. a single "theoretical arrival time" CAS'ed forward)
+	// followed by 1-in-N sampling; suppressed records are counted and summarized at the same
+	// level every m_SummarySecs by whichever thread next hits the limiter, or on ReportAll()
+
+class LogLimiter
+{
+public:
+	LogLimiter(const LogLimit &limit, const char *site = nil);
+	~LogLimiter();
+	
+	// false if record should be dropped (counted)
+	bool	Admit(const LogLevel lvl);
+	
+	// emits pending summaries of all limiters, due ones only unless forced
+	// (a background reporter does it once a second after the first dropped record)
+	static void	ReportDue(const bool force_f);
+	static void	ReportAll(void);
+	static void	StopReporter(void);
+	
+private:
+
+	void	Report(const int64_t now_us, const bool force_f);
+	bool	TakeSummary(const int64_t now_us, const bool force_f, LogLevel &lvl, string &msg);
+	
+	const char		*m_Site;		// (file:line of call site, if any)
+	const int64_t		m_IntervalUS;		// per token
+	const int64_t		m_ToleranceUS;		// burst slack
+	const uint32_t		m_SampleN;
+	const int64_t		m_SummaryUS;
+	
+	atomic<int64_t>		m_ArrivalUS;		// theoretical arrival time
+	atomic<uint64_t>	m_SampleCount;
+	atomic<uint64_t>	m_Suppressed;
+	atomic<int64_t>		m_LastReportUS;
+	atomic<int64_t>		m_FirstSuppressedUS;	// since last summary, 0 if none
+	atomic<LogLevel>	m_LastLevel;		// of last dropped record
+	
+	// no class copy
+	LogLimiter(const LogLimiter &) = delete;
+	LogLimiter& operator=(const LogLimiter&) = delete;
+};
+
 //---- Log Signal -------------------------------------------------------------
 
+	// emitters iterate an immutable snapshot of the slot list without locking, along with a
+	// level -> slot bitmask table so only subscribed slots are visited (up to MAX_SLOTS)
+	// Connect/Disconnect/subscriptions publish a new snapshot then wait until no other thread is still emitting through an
+	// older one, so a disconnected slot can be destroyed right away. From inside a slot call
+	// (i.e. while emitting) there is no such wait: the calling thread skips the slot, but
+	// other threads may still be inside it until their emission returns
+
 class LogSignal
 {
+	friend class LogSlot;
+	friend class rootLog;
+	
 public:
+	static constexpr size_t	MAX_SLOTS = 64;
+	
 	LogSignal();
 	virtual ~LogSignal();
 
-	void	Connect(LogSlot *slot);
-	void	Disconnect(LogSlot *slot);
+	virtual void	Connect(LogSlot *slot);
+	virtual void	Disconnect(LogSlot *slot);
 	
 	// shouldn't be here?
-	void	EmitAll(const timestamp_t stamp, const LogLevel level, const string &msg, const thread::id thread_id) const;
+	void	EmitAll(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_index) const;
+	void	EmitAll(const LogRecord &rec) const;
+	
+	// true if any connected slot subscribes to lvl
+	bool	HasSlotFor(const LogLevel lvl) const;
+	bool	HasSlotForID(const LogLevelID id) const;
+	
+	static size_t	GetThreadIndex(void);		// (of calling thread)
 	
 private:
 
+	template<typename _Fn>
+	void	ForEachSlot(const LogLevel lvl, _Fn fn) const;
+	void	Subscribe(LogSlot *slot, const bool all_f, const unordered_set<LogLevel> &levels);
+	void	Publish(const vector<LogSlot*> &slots, unique_lock<mutex> &locker);
 	void	DisconnectAll(void);
 	
-	size_t	GetThreadIndex(const thread::id tread_id) const;			// not really CONST!!
-	
-	vector<LogSlot*>			m_SlotList;
+	mutex					m_SlotMutex;		// (writers only)
+	atomic<const SlotTable*>		m_SlotTable;
+	vector<std::pair<uint64_t, unique_ptr<const SlotTable>>>	m_RetiredTables;		// (with retire epoch)
 	
-	mutable	mutex					m_Mutex;
-	mutable unordered_map<thread::id, size_t>	m_ThreadIdMap;
+	// level id -> slot bitmask of the current table, read without any guard so every mask
+	// set ever published is kept (once, re-used when the same subscriptions come back)
+	atomic<const SlotMasks*>		m_SlotMasks;
+	vector<unique_ptr<const SlotMasks>>	m_MaskSets;
 
 	// no class copy
 	LogSignal(const LogSignal &) = delete;
@@ -120,7 +414,17 @@ public:
 	rootLog();
 	virtual ~rootLog();
 
-	void	DoULog(const LogLevel lvl, const string &msg);
+	void	DoULog(const LogLevel lvl, string msg);
+	
+	// async dispatch (opt-in)
+	rootLog&	StartAsync(const size_t queue_size = 8192, const LOG_OVERFLOW_T overflow = LOG_OVERFLOW_T::BLOCK);
+	rootLog&	StopAsync(void);
+	bool		IsAsync(void) const;
+	void		Flush(void);
+	
+	// deferred formatting (rendered by async consumer, or by the first slot needing text)
+	rootLog&	SetDeferredFormat(const bool f);
+	bool		IsDeferredFormat(void) const;
 	
 	// functions
 	rootLog&	ClearAllLevels(void);
@@ -129,17 +433,58 @@ public:
 	rootLog&	ToggleLevel(const LogLevel lvl, const bool f);
 	rootLog&	EnableLevel(const char *level_s);
 	
+	// per-level rate limit / sampling (a call site can also pass its own LogLimiter to uLog)
+	rootLog&	SetLevelLimit(const LogLevel lvl, const LogLimit &limit);
+	rootLog&	ClearLevelLimit(const LogLevel lvl);
+	
+	// opt-in: on SIGSEGV/SIGABRT/SIGBUS/SIGFPE/SIGILL, file slots write() out their pending
+	// buffer & queued async records, then a final marker line (see xtrap_fatal); install it
+	// early, a thread gets its alternate signal stack on its first log after that
+	static bool	InstallCrashHandler(void);
+	
 	bool	IsLevelEnabled(const LogLevel lvl) const;
+	bool	IsLevelIDEnabled(const LogLevelID id) const;
 	unordered_set<LogLevel>	GetEnabledLevels(void) const;
 	
 	static rootLog*	GetSingleton(void);
 	static rootLog&	Get(void);
 	static bool	HasLogLevel_LL(const LogLevel lvl);
-	static void	DoULog_LL(const LogLevel lvl, const string &msg);
+	static bool	AdmitLevel_LL(const LogLevel lvl);
+	static void	DoULog_LL(const LogLevel lvl, string msg);
+	
+	// calling thread's (cleared) message buffer, capacity is reused across lines
+	static string&	MsgBuffer_LL(void);
+	static void	DoULogBuffer_LL(const LogLevel lvl, string &buff, const LogSite *site = nil);
+	static bool	IsDeferred_LL(void);
+	static void	DoULogDeferred_LL(const LogLevel lvl, const char *fmt, const xargs &args, const LogSite *site = nil);
+	static void	DoULogFields_LL(const LogLevel lvl, const xargs &fields);
 	
 private:
 
+	void	PublishLevels(void);
+	void	PublishLimits(unique_lock<mutex> &locker, unique_ptr<LogLimiter> replaced);
+	
+	static void	OnFatalSignal(const int sig);
+	
+	using LimitMap = unordered_map<LogLevel, unique_ptr<LogLimiter>>;
+	using LimitTable = vector<LogLimiter*>;			// (by level id)
+	
+	// writers edit the set under mutex then publish an immutable table, readers never lock nor
+	// guard, so every distinct table published is kept until dtor (re-used when toggled back)
+	mutable mutex			m_LevelMutex;
 	unordered_set<LogLevel>		m_EnabledLevelSet;
+	atomic<const LevelTable*>	m_LevelTable;
+	vector<unique_ptr<const LevelTable>>	m_LevelTables;
+	
+	// same scheme for level limits (under level mutex)
+	LimitMap				m_LevelLimits;
+	atomic<const LimitTable*>		m_LimitTable;		// nil if no limits (owned)
+	vector<std::pair<uint64_t, unique_ptr<const LimitTable>>>	m_RetiredLimitTables;		// (with retire epoch)
+	vector<std::pair<uint64_t, unique_ptr<LogLimiter>>>		m_RetiredLimiters;
+	
+	unique_ptr<AsyncLog>		m_AsyncLog;		// (created once, kept until dtor)
+	atomic<AsyncLog*>		m_AsyncPtr;		// non-nil while async dispatch is running
+	atomic<bool>			m_DeferredFlag;
 	
 	// no class copy
 	rootLog(const rootLog &) = delete;
@@ -172,39 +517,246 @@ BASE_LOG_MACRO(	LOG_DEF)
 
 constexpr LogLevel	LOG_NIL((LogLevel)0);
 
+//---- Stripped tags ----------------------------------------------------------
+
+	// tags listed in LX_STRIP_LOG_TAGS (comma-separated string literals, see CMake option)
+	// are compiled out: uLog() / LX_LOG() on such a constant tag, or the uMsg() & co wrappers
+	// of such a tag, are no-ops whose arguments aren't evaluated.
+	// enabling a stripped tag at runtime has no effect
+
+#ifdef LX_STRIP_LOG_TAGS
+constexpr const char*	STRIPPED_LOG_TAGS[] = {LX_STRIP_LOG_TAGS};
+#endif
+
+constexpr
+bool	log_stripped(const LogLevel lvl)
+{
+#ifdef LX_STRIP_LOG_TAGS
+	for (const char *tag : STRIPPED_LOG_TAGS)
+	{
+		if (log_hash(tag) == lvl)	return true;
+	}
+#endif
+	(void)lvl;
+	
+	return false;
+}
+
+constexpr
+bool	log_stripped(const char *lvl_s)
+{
+	return log_stripped(log_hash(lvl_s));
+}
+
+// (limiter overload, its level is checked by uLogLimit)
+constexpr
+bool	log_stripped(const LogLimiter&)
+{
+	return false;
+}
+
 #ifdef WIN32
 	#pragma warning(default:4307)
 #endif
 
 #undef BASE_LOG_MACRO
 
-} // namespace LX
+//---- uLog implementation ----------------------------------------------------
+
+	// deferral only ships the format POINTER, so is restricted to formats that outlive the process'
+	// records: "..."_fmt and LX_LOG() literals. plain const char* may point to a stack or heap buffer,
+	// so it's always rendered on the calling thread
 
 template<typename ... Args>
-void	uLog(const LX::LogLevel lvl, const char *fmt, Args&& ... args)
+bool	ulog_defer(std::true_type, const LogLevel lvl, const LogSite *site, const char *fmt, const Args& ... args)
+{
+	if (!rootLog::IsDeferred_LL())		return false;
+	
+	xargs	xa;
+	
+	if (!xa.Pack(args...))			return false;		// too big, format on the spot
+	
+	rootLog::DoULogDeferred_LL(lvl, fmt, xa, site);
+	return true;
+}
+
+template<typename ... Args>
+bool	ulog_defer(std::false_type, const LogLevel, const LogSite*, const char*, const Args& ...)
+{
+	return false;
+}
+
+	// level already checked (or cached by call site)
+
+template<bool _STATIC_FMT, typename ... Args>
+void	ulog_emit(const LogLevel lvl, const LogSite *site, const char *fmt, Args&& ... args)
 {
 	try
 	{
-		if (!LX::rootLog::HasLogLevel_LL(lvl))	return;		// (won't preempt log string unfolding)
+		if (!rootLog::AdmitLevel_LL(lvl))	return;		// rate-limited or not sampled
+		
+		using defer_t = std::integral_constant<bool, _STATIC_FMT && xargs_deferrable<Args...>::value>;
+		
+		if (ulog_defer(defer_t{}, lvl, site, fmt, args...))	return;
 			
-		const std::string	msg = LX::xsprintf(fmt, std::forward<Args>(args) ...);
-		LX::rootLog::DoULog_LL(lvl, msg);
+		std::string	&msg = rootLog::MsgBuffer_LL();
+		xout		out(msg);
+		
+		xformatto(out, fmt, args...);
+		rootLog::DoULogBuffer_LL(lvl, msg, site);
 	}
 	catch (std::runtime_error &e)
 	{
 		const char	*what_s = e.what();	// (don't allocate)
-		LX::xtrap(what_s);
+		xtrap(what_s);
 		
 		throw e;	// re-throw
 	}
 }
 
+	// compile-time checked format ("..."_fmt), no runtime parsing & no exceptions
+
+template<char ... _Cs, typename ... Args>
+void	ulog_emit(const LogLevel lvl, const LogSite *site, xfmt<_Cs...> fmt, const Args& ... args)
+{
+	if (!rootLog::AdmitLevel_LL(lvl))	return;
+	
+	using defer_t = std::integral_constant<bool, xargs_deferrable<Args...>::value>;
+	
+	if (ulog_defer(defer_t{}, lvl, site, fmt.c_str(), args...))	return;
+	
+	std::string	&msg = rootLog::MsgBuffer_LL();
+	xout		out(msg);
+	
+	xformatto(out, fmt, args...);
+	rootLog::DoULogBuffer_LL(lvl, msg, site);
+}
+
+// (LX_LOG only, which makes sure fmt is a literal)
+template<typename ... Args>
+void	ulog_site(const LogSite &site, const char *fmt, Args&& ... args)
+{
+	ulog_emit<true>(site.m_Level, &site, fmt, std::forward<Args>(args) ...);
+}
+
+template<char ... _Cs, typename ... Args>
+void	ulog_site(const LogSite &site, xfmt<_Cs...> fmt, const Args& ... args)
+{
+	ulog_emit(site.m_Level, &site, fmt, args...);
+}
+
+template<bool _STATIC_FMT, typename ... Args>
+void	ulog_impl(const LogLevel lvl, const char *fmt, Args&& ... args)
+{
+	if (log_stripped(lvl))			return;		// (folded away if lvl is constant)
+	if (!rootLog::HasLogLevel_LL(lvl))	return;		// (won't preempt log string unfolding)
+	
+	ulog_emit<_STATIC_FMT>(lvl, nil, fmt, std::forward<Args>(args) ...);
+}
+
+template<char ... _Cs, typename ... Args>
+void	ulog_impl(const LogLevel lvl, xfmt<_Cs...> fmt, const Args& ... args)
+{
+	if (log_stripped(lvl))			return;
+	if (!rootLog::HasLogLevel_LL(lvl))	return;
+	
+	ulog_emit(lvl, nil, fmt, args...);
+}
+
+//---- Structured (key/value) logging -----------------------------------------
+
+	// uLogKV(lvl, "msg", kv("user", id), kv("ms", dt)) packs the message & typed values
+	// into the record (no text), so a JSON slot writes them out as is while text slots
+	// get "msg user=42 ms=1.5" rendered on demand; values must be POD or strings
+
+template<typename _T>
+struct LogField
+{
+	const char	*m_Key;
+	const _T	&m_Val;			// (lives till end of uLogKV statement)
+};
+
+template<typename _T>
+LogField<_T>	kv(const char *key, const _T &val)
+{
+	static_assert(xarg_traits<_T>::tag() != XARG_T::NONE, "kv() value must be plain-old-data or a string");
+	
+	return LogField<_T>{key, val};
+}
+
+inline
+bool	ulog_pack_fields(xargs &)
+{
+	return true;
+}
+
+template<typename _T, typename ... Fields>
+bool	ulog_pack_fields(xargs &xa, const LogField<_T> &field, const Fields& ... fields)
+{
+	return xa.Append(field.m_Key, field.m_Val) && ulog_pack_fields(xa, fields...);
+}
+
+inline
+void	ulog_text_fields(xout &)
+{
+}
+
+template<typename _T, typename ... Fields>
+void	ulog_text_fields(xout &out, const LogField<_T> &field, const Fields& ... fields)
+{
+	LogRecord::AppendField(out, xargview(field.m_Key), xargview(field.m_Val));
+	
+	ulog_text_fields(out, fields...);
+}
+
+template<typename _M, typename ... _Ts>
+void	ulog_kv(const LogLevel lvl, const _M &msg, const LogField<_Ts>& ... fields)
+{
+	static_assert(xarg_traits<_M>::tag() == XARG_T::STR, "uLogKV() message must be a string");
+	
+	if (log_stripped(lvl))			return;
+	if (!rootLog::HasLogLevel_LL(lvl))	return;
+	if (!rootLog::AdmitLevel_LL(lvl))	return;
+	
+	xargs	xa;
+	
+	if (xa.Pack(msg) && ulog_pack_fields(xa, fields...))
+	{
+		rootLog::DoULogFields_LL(lvl, xa);
+		return;
+	}
+	
+	// too big to pack, falls back to text
+	std::string	&text = rootLog::MsgBuffer_LL();
+	xout		out(text);
+	const xarg_view	msg_v = xargview(msg);
+	
+	out.append(msg_v.m_Data, msg_v.m_Size);
+	ulog_text_fields(out, fields...);
+	
+	rootLog::DoULogBuffer_LL(lvl, text);
+}
+
+} // namespace LX
+
+template<typename ... Args>
+void	uLog(const LX::LogLevel lvl, const char *fmt, Args&& ... args)
+{
+	LX::ulog_impl<false>(lvl, fmt, std::forward<Args>(args) ...);
+}
+
 // overloads
 
 template<typename ... Args>
 void	uLog(const LX::LogLevel lvl, const std::string &fmt, Args&& ... args)
 {
-	uLog(lvl, fmt.c_str(), std::forward<Args>(args) ...);
+	LX::ulog_impl<false>(lvl, fmt.c_str(), std::forward<Args>(args) ...);
+}
+
+template<char ... _Cs, typename ... Args>
+void	uLog(const LX::LogLevel lvl, LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	LX::ulog_impl(lvl, fmt, args...);
 }
 
 template<typename ... Args>
@@ -213,36 +765,175 @@ void	uLog(const char lvl_s[], const char *fmt, Args&& ... args)
 	uLog(LX::log_hash(lvl_s), fmt, std::forward<Args>(args) ...);
 }
 
+template<char ... _Cs, typename ... Args>
+void	uLog(const char lvl_s[], LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	LX::ulog_impl(LX::log_hash(lvl_s), fmt, args...);
+}
+
+// per call-site limiter (checked before the level's own limit), level is checked once
+
+template<typename ... Args>
+void	uLog(LX::LogLimiter &limiter, const LX::LogLevel lvl, const char *fmt, Args&& ... args)
+{
+	if (LX::log_stripped(lvl) || !LX::rootLog::HasLogLevel_LL(lvl) || !limiter.Admit(lvl))	return;
+	
+	LX::ulog_emit<false>(lvl, nil, fmt, std::forward<Args>(args) ...);
+}
+
+template<char ... _Cs, typename ... Args>
+void	uLog(LX::LogLimiter &limiter, const LX::LogLevel lvl, LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	if (LX::log_stripped(lvl) || !LX::rootLog::HasLogLevel_LL(lvl) || !limiter.Admit(lvl))	return;
+	
+	LX::ulog_emit(lvl, nil, fmt, args...);
+}
+
+// structured, e.g. uLogKV("NET"_log, "connected", kv("host", host), kv("ms", dt));
+
+template<typename _M, typename ... _Ts>
+void	uLogKV(const LX::LogLevel lvl, const _M &msg, const LX::LogField<_Ts>& ... fields)
+{
+	LX::ulog_kv(lvl, msg, fields...);
+}
+
+// call site with its own (static) limiter, e.g.
+//   uLogRate(5, WARNING, "retrying %s", host);		// at most 5/sec
+//   uLogEvery(1000, "IO"_log, "read %zu", n);		// 1 in 1000
+
+#define LX_LOG_STR2(s)	#s
+#define LX_LOG_STR(s)	LX_LOG_STR2(s)
+#define LX_LOG_SITE	__FILE__ ":" LX_LOG_STR(__LINE__)
+
+#define uLogLimit(limit, lvl, ...)											\
+	do {	const LX::LogLevel	lx_limit_lvl = (lvl);								\
+		if (LX::log_stripped(lx_limit_lvl))	break;								\
+		static LX::LogLimiter	s_lx_site_limiter(limit, LX_LOG_SITE);						\
+		uLog(s_lx_site_limiter, lx_limit_lvl, __VA_ARGS__);							\
+	} while (0)
+
+#define uLogRate(per_sec, lvl, ...)	uLogLimit((LX::LogLimit{(double)(per_sec), (double)(per_sec)}), lvl, __VA_ARGS__)
+#define uLogEvery(n, lvl, ...)		uLogLimit((LX::LogLimit{0, 1, (uint32_t)(n)}), lvl, __VA_ARGS__)
+
+// static call site: the disabled check is a relaxed load of the site's cached state,
+// and records carry the site (level, format, file & line) at no per-call cost, e.g.
+//   LX_LOG(WARNING, "retrying %s", host);
+//   LX_LOG("IO"_log, "read %zu bytes"_fmt, n);
+// (the site is initialized once, so the level must be a constant and the format a literal
+// or "..."_fmt, anything else fails to compile)
+
+#define LX_LOG(lvl, fmt, ...)												\
+	do {	constexpr LX::LogLevel	lx_log_lvl = (lvl);								\
+		if (LX::log_stripped(lx_log_lvl))	break;								\
+		static LX::LogSite	s_lx_log_site(lx_log_lvl, "" fmt, __FILE__, __LINE__);				\
+		if (s_lx_log_site.IsEnabled())										\
+			LX::ulog_site(s_lx_log_site, "" fmt, ##__VA_ARGS__);						\
+	} while (0)
+
 // base shortcuts/wrappers
 
+template<typename ... Args>
+void	uMsg(const char *fmt, Args&& ... args)
+{
+	uLog(LX::LX_MSG, fmt, std::forward<Args>(args) ...);
+}
+
 template<typename ... Args>
 void	uMsg(const std::string &fmt, Args&& ... args)
 {
 	uLog(LX::LX_MSG, fmt, std::forward<Args>(args) ...);
 }
 
+template<char ... _Cs, typename ... Args>
+void	uMsg(LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	LX::ulog_impl(LX::LX_MSG, fmt, args...);
+}
+
+template<typename ... Args>
+void	uWarn(const char *fmt, Args&& ... args)
+{
+	uLog(LX::WARNING, fmt, std::forward<Args>(args) ...);
+}
+
 template<typename ... Args>
 void	uWarn(const std::string &fmt, Args&& ... args)
 {
 	uLog(LX::WARNING, fmt, std::forward<Args>(args) ...);
 }
 
+template<char ... _Cs, typename ... Args>
+void	uWarn(LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	LX::ulog_impl(LX::WARNING, fmt, args...);
+}
+
+template<typename ... Args>
+void	uErr(const char *fmt, Args&& ... args)
+{
+	uLog(LX::LX_ERROR, fmt, std::forward<Args>(args) ...);
+}
+
 template<typename ... Args>
 void	uErr(const std::string &fmt, Args&& ... args)
 {
 	uLog(LX::LX_ERROR, fmt, std::forward<Args>(args) ...);
 }
 
+template<char ... _Cs, typename ... Args>
+void	uErr(LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	LX::ulog_impl(LX::LX_ERROR, fmt, args...);
+}
+
+template<typename ... Args>
+void	uExcept(const char *fmt, Args&& ... args)
+{
+	uLog(LX::EXCEPTION, fmt, std::forward<Args>(args) ...);
+}
+
 template<typename ... Args>
 void	uExcept(const std::string &fmt, Args&& ... args)
 {
 	uLog(LX::EXCEPTION, fmt, std::forward<Args>(args) ...);
 }
 
+template<char ... _Cs, typename ... Args>
+void	uExcept(LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	LX::ulog_impl(LX::EXCEPTION, fmt, args...);
+}
+
+template<typename ... Args>
+void	uFatal(const char *fmt, Args&& ... args)
+{
+	uLog(LX::FATAL, fmt, std::forward<Args>(args) ...);
+}
+
 template<typename ... Args>
 void	uFatal(const std::string &fmt, Args&& ... args)
 {
 	uLog(LX::FATAL, fmt, std::forward<Args>(args) ...);
 }
 
+template<char ... _Cs, typename ... Args>
+void	uFatal(LX::xfmt<_Cs...> fmt, const Args& ... args)
+{
+	LX::ulog_impl(LX::FATAL, fmt, args...);
+}
+
+#ifdef LX_STRIP_LOG_TAGS
+	// skips argument evaluation for stripped tags and stays an expression; the level is evaluated
+	// once as a lambda argument, the arguments inside its body (so __func__ there names the lambda)
+	#define uLog(lvl, ...)		([&](auto &&lx_lvl){LX::log_stripped(lx_lvl) ? void() : (uLog)(lx_lvl, __VA_ARGS__);}(lvl))
+	#define uLogKV(lvl, ...)	([&](auto &&lx_lvl){LX::log_stripped(lx_lvl) ? void() : (uLogKV)(lx_lvl, __VA_ARGS__);}(lvl))
+	
+	// (constant tags)
+	#define uMsg(...)	(LX::log_stripped(LX::LX_MSG) ? void() : (uMsg)(__VA_ARGS__))
+	#define uWarn(...)	(LX::log_stripped(LX::WARNING) ? void() : (uWarn)(__VA_ARGS__))
+	#define uErr(...)	(LX::log_stripped(LX::LX_ERROR) ? void() : (uErr)(__VA_ARGS__))
+	#define uExcept(...)	(LX::log_stripped(LX::EXCEPTION) ? void() : (uExcept)(__VA_ARGS__))
+	#define uFatal(...)	(LX::log_stripped(LX::FATAL) ? void() : (uFatal)(__VA_ARGS__))
+#endif
+
 // nada mas
@@ -0,0 +1,28 @@
+// lx utils fast block codec
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace LX
+{
+
+// byte-oriented LZ77 in the spirit of LZ4: 4-byte min match, 64k window, no entropy stage
+// favors speed over ratio, text logs typically shrink 3-6x
+
+std::size_t	LZCompressBound(const std::size_t n);
+
+// returns compressed size, 0 if dst is too small
+std::size_t	LZCompress(const char *src, const std::size_t n, char *dst, const std::size_t cap);
+
+// returns decompressed size, (size_t)-1 if corrupt or dst too small
+std::size_t	LZDecompress(const char *src, const std::size_t n, char *dst, const std::size_t cap);
+
+// whole-file wrappers ("LXZ1" header + independent blocks), write to dst_fn
+bool	LZCompressFile(const std::string &src_fn, const std::string &dst_fn);
+bool	LZDecompressFile(const std::string &src_fn, const std::string &dst_fn);
+
+} // namespace LX
+
+// nada mas
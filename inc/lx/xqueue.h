@@ -0,0 +1,159 @@
+// lx utils bounded lock-free queue
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace LX
+{
+
+//---- bounded multi-producer / single-consumer ring --------------------------
+
+	// after Dmitry Vyukov's bounded MPMC queue
+	//   http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+	// each cell carries a sequence number telling producers/consumer whose turn it is,
+	// producers only contend on one CAS, the (single) consumer doesn't CAS at all
+
+template<typename _T>
+class mpsc_queue
+{
+	static constexpr size_t	CACHE_LINE = 64;
+	
+	struct cell
+	{
+		std::atomic<size_t>	m_Seq;
+		_T			m_Val;
+	};
+	
+	static
+	size_t	RoundUpPow2(const size_t n)
+	{
+		size_t	sz = 2;
+		
+		while (sz < n)	sz <<= 1;
+		
+		return sz;
+	}
+
+public:
+	// ctor
+	explicit mpsc_queue(const size_t capacity)
+		: m_Mask(RoundUpPow2(capacity) - 1),
+		m_Cells(new cell[m_Mask + 1]),
+		m_Pad0{},
+		m_EnqueuePos(0),
+		m_Pad1{},
+		m_DequeuePos(0),
+		m_Pad2{}
+	{
+		for (size_t i = 0; i <= m_Mask; i++)
+			m_Cells[i].m_Seq.store(i, std::memory_order_relaxed);
+	}
+	
+	size_t	capacity(void) const		{return m_Mask + 1;}
+	
+	// number of successful pushes so far (monotonic)
+	size_t	pushed(void) const		{return m_EnqueuePos.load(std::memory_order_acquire);}
+	
+	// any producer thread, returns false if full (val is then left untouched)
+	bool	try_push(_T &&val)
+	{
+		size_t	pos = m_EnqueuePos.load(std::memory_order_relaxed);
+		
+		for (;;)
+		{
+			cell		&c = m_Cells[pos & m_Mask];
+			const size_t	seq = c.m_Seq.load(std::memory_order_acquire);
+			const intptr_t	dif = (intptr_t)seq - (intptr_t)pos;
+			
+			if (0 == dif)
+			{	// cell is free for this lap, try to claim it
+				if (m_EnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					c.m_Val = std::move(val);
+					c.m_Seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+				// (pos was reloaded by failed CAS)
+			}
+			else if (dif < 0)
+			{	// consumer hasn't freed this cell yet
+				return false;
+			}
+			else
+			{	// another producer got it first
+				pos = m_EnqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+	
+	// consumer thread ONLY
+	bool	try_pop(_T &val)
+	{
+		const size_t	pos = m_DequeuePos.load(std::memory_order_relaxed);
+		cell		&c = m_Cells[pos & m_Mask];
+		const size_t	seq = c.m_Seq.load(std::memory_order_acquire);
+		
+		if ((intptr_t)seq - (intptr_t)(pos + 1) < 0)	return false;	// empty (or producer not done writing)
+		
+		// mark taken before moving out: producers still see it full, peek() sees it empty
+		c.m_Seq.store(pos, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		
+		val = std::move(c.m_Val);
+		c.m_Seq.store(pos + m_Mask + 1, std::memory_order_release);
+		
+		m_DequeuePos.store(pos + 1, std::memory_order_release);
+		
+		return true;
+	}
+
+	// any thread, best effort (e.g. from a fatal signal handler): visits values pushed but not
+	// popped yet, oldest first, without taking them
+	// the consumer may be moving them out meanwhile, so copy() must only read fixed-size
+	// fields into caller storage; use() is called once the cell is confirmed unchanged
+	template<typename _Copy, typename _Use>
+	void	peek(_Copy copy, _Use use) const
+	{
+		const size_t	head = m_DequeuePos.load(std::memory_order_acquire);
+		
+		for (size_t pos = head; pos <= (head + m_Mask); pos++)
+		{
+			const cell	&c = m_Cells[pos & m_Mask];
+			
+			if (c.m_Seq.load(std::memory_order_acquire) != (pos + 1))	break;	// (empty, being written or taken)
+			
+			copy(c.m_Val);
+			
+			std::atomic_thread_fence(std::memory_order_acquire);
+			
+			if (c.m_Seq.load(std::memory_order_relaxed) != (pos + 1))	break;	// (taken during copy)
+			
+			use();
+		}
+	}
+
+private:
+
+	const size_t			m_Mask;
+	std::unique_ptr<cell[]>		m_Cells;
+	
+	// (padded so producers & consumer don't false-share)
+	char				m_Pad0[CACHE_LINE];
+	std::atomic<size_t>		m_EnqueuePos;
+	char				m_Pad1[CACHE_LINE - sizeof(size_t)];
+	std::atomic<size_t>		m_DequeuePos;
+	char				m_Pad2[CACHE_LINE - sizeof(size_t)];
+	
+	// no class copy
+	mpsc_queue(const mpsc_queue &) = delete;
+	mpsc_queue &operator=(const mpsc_queue &) = delete;
+};
+
+} // namespace LX
+
+// nada mas
@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -13,6 +14,7 @@
 #include <thread>
 #include <stdexcept>
 #include <type_traits>
+#include <algorithm>
 
 #if LX_WX
 	#include "wx/string.h"
@@ -31,7 +33,139 @@ std::string	ToHumanTime(const double secs, const bool ms_f);
 
 using outstream = std::ostringstream;
 
-void	xhandleprefix(const char *&s, outstream &ss);
+//---- output sink ------------------------------------------------------------
+
+	// appends to a std::string (growing) or into a fixed buffer (truncating, never allocates),
+	// either way counts the full untruncated length, like snprintf()
+
+class xout
+{
+public:
+	explicit xout(std::string &s)
+		: m_Str(&s), m_Buff(nullptr), m_Cap(0), m_Len(0)
+	{
+	}
+	
+	xout(char *buff, const size_t cap)
+		: m_Str(nullptr), m_Buff(buff), m_Cap(cap), m_Len(0)
+	{
+	}
+	
+	void	append(const char *p, const size_t n)
+	{
+		if (m_Str)			m_Str->append(p, n);
+		else if (m_Len < m_Cap)		::memcpy(m_Buff + m_Len, p, std::min(n, m_Cap - m_Len));
+		
+		m_Len += n;
+	}
+	
+	void	append(const size_t n, const char c)
+	{
+		if (m_Str)			m_Str->append(n, c);
+		else if (m_Len < m_Cap)		::memset(m_Buff + m_Len, c, std::min(n, m_Cap - m_Len));
+		
+		m_Len += n;
+	}
+	
+	void	append(const std::string &s)	{append(s.data(), s.size());}
+	
+	void	push_back(const char c)
+	{
+		if (m_Str)			m_Str->push_back(c);
+		else if (m_Len < m_Cap)		m_Buff[m_Len] = c;
+		
+		m_Len++;
+	}
+	
+	// chars appended, including any truncated
+	size_t	size(void) const	{return m_Len;}
+	
+private:
+	
+	std::string	*m_Str;
+	char		*m_Buff;
+	const size_t	m_Cap;
+	size_t		m_Len;
+};
+
+//---- format spec (shared by runtime & compile-time parsing) -----------------
+
+struct xspec
+{
+	char	m_Conv;			// conversion char
+	bool	m_ShowPos;		// '+'
+	char	m_Fill;			// ' ' or '0' if width
+	int	m_Width;
+	int	m_Precision;		// -1 if none
+};
+
+constexpr
+bool	xisdigit(const char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+// parses spec following '%' (not "%%") at s[i], leaves i past the conversion char
+// throws on malformed spec, i.e. is a compile error when constant-evaluated
+constexpr
+xspec	xparsespec(const char *s, size_t &i)
+{
+	xspec	spec{0, false, 0, 0, -1};
+	
+	// SIGN prefix
+	if ('+' == s[i])
+	{	spec.m_ShowPos = true;
+		i++;
+	}
+	
+	// FILL prefix and WIDTH, multi-digit width & precision are plain decimal like printf()'s
+	// (until the "_fmt" parser they were mis-accumulated: "%12d" padded to 13, "%.10f" had 11 decimals)
+	if (xisdigit(s[i]))	spec.m_Fill = ('0' == s[i]) ? '0' : ' ';
+	
+	while (xisdigit(s[i]))
+		spec.m_Width = (spec.m_Width * 10) + (s[i++] - '0');
+	
+	if ('.' == s[i])
+	{
+		i++;
+		spec.m_Precision = 0;
+		
+		while (xisdigit(s[i]))
+			spec.m_Precision = (spec.m_Precision * 10) + (s[i++] - '0');
+	}
+	
+	// skip any size specifier
+	switch (s[i])
+	{	case 'z':		// size_t
+		case 'h':		// short / unsigned short
+		case 'l':		// long / unsigned long
+		case 'L':		// long double
+		
+			i++;
+			if (0 == s[i])	throw std::runtime_error("incomplete size format specifier in xprintf()");
+			break;
+		
+		default:
+		
+			break;
+	}
+	
+	if (0 == s[i])	throw std::runtime_error("unhandled xsprintf() format flag");
+	
+	spec.m_Conv = s[i++];
+	
+	return spec;
+}
+
+// sets stream state for spec (from scratch)
+void	xapplyspec(const xspec &spec, outstream &ss);
+
+// appends vanilla chars up to next conversion, returns its parsed spec
+xspec	xhandleprefix(const char *&s, xout &out);
+
+// appends remaining vanilla chars, throws if a conversion is left
+void	xformatto(xout &out, const char *s);
+
 // no-arg specialization
 std::string	xsprintf(const char *s);
 
@@ -72,120 +206,779 @@ void	xdump(const std::thread::id &thread_id, outstream &ss);
 	}
 #endif
 
-// full vararg sprintf() re-implementation
-template<typename _T, typename ... Args>
-std::string	xsprintf(const char *s, const _T &val, Args&& ... args)
+//---- argument / conversion compatibility ------------------------------------
+
+template<typename _T>
+struct xconv_traits
 {
-	using namespace std;
-	
-	outstream	ss;
-	
-	xhandleprefix(s/*&*/, ss/*&*/);
-	
-	const char	fmt_c = *s++;
-	const bool	integral_f = is_integral<_T>();
-	const bool	float_f = is_floating_point<_T>();
-	const bool	enum_f = is_enum<_T>();
-	const bool	int_conv_f = is_convertible<_T, int>();
-	const bool	thread_f = is_same<_T, std::thread::id>();
-	const bool	int_f = integral_f || (enum_f && int_conv_f) || thread_f;		// tortuous accomodation for enums
-	const bool	number_f = int_f || float_f;
-	const bool	ptr_f = true;	// (is_pointer<_T>()) || (is_member_object_pointer<_T>()) || (is_member_function_pointer<_T>()) || (is_pointer<void>());
+	static constexpr bool	integral_f = std::is_integral<_T>::value;
+	static constexpr bool	float_f = std::is_floating_point<_T>::value;
+	static constexpr bool	enum_f = std::is_enum<_T>::value;
+	static constexpr bool	int_conv_f = std::is_convertible<_T, int>::value;
+	static constexpr bool	thread_f = std::is_same<_T, std::thread::id>::value;
+	static constexpr bool	int_f = integral_f || (enum_f && int_conv_f) || thread_f;		// tortuous accomodation for enums
+	static constexpr bool	number_f = int_f || float_f;
 	
 	#if LX_WX
-		const bool	wxstring_f = is_same<_T, wxString>();
+		static constexpr bool	wxstring_f = std::is_same<_T, wxString>::value;
 	#else
-		const bool	wxstring_f = false;
+		static constexpr bool	wxstring_f = false;
 	#endif
 	
 	#if LX_JUCE
-		const bool	juce_string_f = is_same<_T, juce::String>();
+		static constexpr bool	juce_string_f = std::is_same<_T, juce::String>::value;
 	#else
-		const bool	juce_string_f = false;
+		static constexpr bool	juce_string_f = false;
 	#endif
 	
+	static constexpr bool	string_f = std::is_same<_T, std::string>::value || std::is_convertible<_T, const char*>::value || wxstring_f || juce_string_f;
+};
+
+// error message if _T can't be formatted with conversion char c, else nullptr
+template<typename _T>
+constexpr
+const char*	xconverror(const char c)
+{
+	using tr = xconv_traits<_T>;
+	
+	switch (c)
+	{
+		case 'c':
+		
+			if (!tr::int_f)			return "bad xsprintf() char format";
+			if (sizeof(_T) != 1)		return "bad xsprintf() char arg size";		// '.' may be passed as int vs char?
+			return nullptr;
+		
+		case 'S':	// QUOTED string
+		case 's':
+		
+			return tr::string_f ? nullptr : "bad xsprintf() string format";
+		
+		case 'd':
+		case 'i':
+		case 'u':					// used to be handled separately
+		
+			return tr::number_f ? nullptr : "bad xsprintf() integer format";
+		
+		case 'X':
+		
+			return tr::int_f ? nullptr : "bad xsprintf() integer format for upper-case hex";
+		
+		case 'x':
+		
+			return tr::int_f ? nullptr : "bad xsprintf() integer format for (lower-case) hex";
+		
+		case 'p':	// ptr
+		
+			return nullptr;
+		
+		case 'g':
+		case 'f':
+		case 'e':
+		case 'E':
+		case 'G':
+		
+			return tr::number_f ? nullptr : "bad xsprintf() float or double format";
+		
+		default:	// unknown format flag
+		
+			return "unhandled xsprintf() format flag";
+	}
+}
+
+//---- single-buffer output ---------------------------------------------------
+
+	// every conversion appends in place to the caller's string, reproducing what
+	// an ostringstream with the spec applied would output; only types without a
+	// native path (user operator<<, thread ids, wide chars) still go through a stream
+
+// appends n chars, front-padded to spec width
+void	xputchars(xout &out, const xspec &spec, const char *p, const size_t n);
+
+// base 0 = decimal, 1 = hex, 2 = upper-case hex
+void	xputint(xout &out, const xspec &spec, const std::uint64_t mag, const bool neg_f, const bool signed_f, const int base);
+void	xputfloat(xout &out, const xspec &spec, const double v);
+void	xputfloat(xout &out, const xspec &spec, const long double v);
+void	xputptr(xout &out, const xspec &spec, const void *p);
+
+enum class XOUT_T : std::uint8_t
+{
+	STREAM = 0,		// via local ostringstream
+	BOOL,
+	CHAR,
+	SINT,
+	UINT,
+	ENUM,
+	FLOAT,
+	LONG_DOUBLE,
+	CSTR,
+	STDSTR,
+};
+
+template<typename _T>
+struct xout_traits
+{
+	using T = typename std::decay<_T>::type;
+	
+	static constexpr bool	wide_f = std::is_same<T, wchar_t>() || std::is_same<T, char16_t>() || std::is_same<T, char32_t>();
+	
+	static constexpr
+	XOUT_T	kind(void)
+	{
+		return	std::is_same<T, bool>() ? XOUT_T::BOOL :
+			(std::is_same<T, char>() || std::is_same<T, signed char>() || std::is_same<T, unsigned char>()) ? XOUT_T::CHAR :
+			(std::is_integral<T>() && !wide_f) ? (std::is_signed<T>() ? XOUT_T::SINT : XOUT_T::UINT) :
+			(std::is_enum<T>() && std::is_convertible<T, int>()) ? XOUT_T::ENUM :
+			(std::is_same<T, float>() || std::is_same<T, double>()) ? XOUT_T::FLOAT :
+			std::is_same<T, long double>() ? XOUT_T::LONG_DOUBLE :
+			(std::is_same<T, const char*>() || std::is_same<T, char*>()) ? XOUT_T::CSTR :
+			std::is_same<T, std::string>() ? XOUT_T::STDSTR : XOUT_T::STREAM;
+	}
+	
+	using tag = std::integral_constant<XOUT_T, kind()>;
+};
+
+// appends what "ss << val" would
+template<typename _T>
+void	xstreamout(xout &out, const xspec &spec, const _T &val, const int base);
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::STREAM>, xout &out, const xspec &spec, const _T &val, const int base)
+{
+	outstream	ss;
+	
+	xapplyspec(spec, ss);
+	if (base)	ss << std::hex << ((2 == base) ? std::uppercase : std::nouppercase);
+	
+	ss << val;
+	
+	out.append(ss.str());
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::BOOL>, xout &out, const xspec &spec, const _T &val, const int base)
+{
+	xputint(out, spec, val ? 1 : 0, false, true/*as long*/, base);
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::CHAR>, xout &out, const xspec &spec, const _T &val, const int)
+{
+	const char	c = val;
+	
+	xputchars(out, spec, &c, 1);
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::SINT>, xout &out, const xspec &spec, const _T &val, const int base)
+{
+	using U = typename std::make_unsigned<_T>::type;
+	
+	if (base)
+		xputint(out, spec, static_cast<U>(val), false, false, base);		// two's complement of same size
+	else if (val < 0)
+		xputint(out, spec, 0 - static_cast<std::uint64_t>(val), true, true, base);
+	else	xputint(out, spec, static_cast<std::uint64_t>(val), false, true, base);
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::UINT>, xout &out, const xspec &spec, const _T &val, const int base)
+{
+	xputint(out, spec, val, false, false, base);
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::ENUM>, xout &out, const xspec &spec, const _T &val, const int base)
+{
+	xstreamout(out, spec, +val, base);		// as promoted integer
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::FLOAT>, xout &out, const xspec &spec, const _T &val, const int)
+{
+	xputfloat(out, spec, static_cast<double>(val));
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::LONG_DOUBLE>, xout &out, const xspec &spec, const _T &val, const int)
+{
+	xputfloat(out, spec, static_cast<long double>(val));
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::CSTR>, xout &out, const xspec &spec, const _T &val, const int)
+{
+	const char	*p = val;
+	
+	if (p)	xputchars(out, spec, p, ::strlen(p));		// (null would set badbit, i.e. no output)
+}
+
+template<typename _T>
+void	xstreamout(std::integral_constant<XOUT_T, XOUT_T::STDSTR>, xout &out, const xspec &spec, const _T &val, const int)
+{
+	xputchars(out, spec, val.data(), val.size());
+}
+
+template<typename _T>
+void	xstreamout(xout &out, const xspec &spec, const _T &val, const int base)
+{
+	xstreamout(typename xout_traits<_T>::tag{}, out, spec, val, base);
+}
+
+// appends what xdump() would, same overload set
+template<typename _T>
+typename std::enable_if<!Has_ToStdStringMethod<_T>::Has,void>::type			// if _T is NOT wxString
+	xdumpout(xout &out, const xspec &spec, const _T &val, const int base)
+{
+	xstreamout(out, spec, val, base);
+}
+
+template<typename _T>
+typename std::enable_if<Has_ToStdStringMethod<_T>::Has,void>::type			// if _T is wxString
+	xdumpout(xout &out, const xspec &spec, const _T &val, const int base)
+{
+	xstreamout(out, spec, val.ToStdString(), base);
+}
+
+inline
+void	xdumpout(xout &out, const xspec &spec, const std::int8_t &i8, const int base)
+{
+	xstreamout(out, spec, (int) i8, base);
+}
+
+inline
+void	xdumpout(xout &out, const xspec &spec, const std::uint8_t &u8, const int base)
+{
+	xstreamout(out, spec, (unsigned int) u8, base);
+}
+
+inline
+void	xdumpout(xout &out, const xspec &spec, const void *p, const int)
+{
+	xputptr(out, spec, p);
+}
+
+void	xdumpout(xout &out, const xspec &spec, const std::thread::id &thread_id, const int base);
+
+#if LX_JUCE
+	inline
+	void	xdumpout(xout &out, const xspec &spec, const juce::String &val, const int base)
+	{
+		xstreamout(out, spec, val.toStdString(), base);
+	}
+#endif
+
+template<typename _T>
+void	xcharout(xout &out, const xspec &spec, const _T &val)
+{
+	xstreamout(out, spec, val, 0);
+}
+
+void	xcharout(xout &out, const xspec &spec, const bool &b);		// boolalpha
+
+// format ONE (already checked) argument
+template<typename _T>
+void	xformatconv(const char fmt_c, const _T &val, const xspec &spec, xout &out)
+{
 	switch (fmt_c)
 	{
 		case 'c':
 		
-			if (!int_f)			throw runtime_error("bad xsprintf() char format");
-			if (sizeof(_T) != 1)		throw runtime_error("bad xsprintf() char arg size");		// '.' may be passed as int vs char?
-			if (is_same<_T, bool>())	ss << boolalpha;
-				
-			ss << val;
+			xcharout(out, spec, val);
 			break;
 		
 		case 'S':	// QUOTED string
 		case 's':
 		{
-			bool	ok = false;
+			// width pads whatever is output first, i.e. opening quote
+			xspec	val_spec = spec;
 			
-			ok |= is_same<_T, std::string>();
-			ok |= is_convertible<_T, const char*>();
-			ok |= wxstring_f;
-			ok |= juce_string_f;
-			if (!ok)
-			{
-				assert(0);
-				throw runtime_error("bad xsprintf() string format");
+			if (fmt_c == 'S')
+			{	xputchars(out, spec, "\"", 1);
+				val_spec.m_Width = 0;
 			}
-			if (fmt_c == 'S')	ss << "\"";
 			
-			if (wxstring_f)		xdump(val, ss);		// wxString
-			else if (juce_string_f)	xdump(val, ss);		// juce::String
-			else			ss << val;
+			if (xconv_traits<_T>::wxstring_f || xconv_traits<_T>::juce_string_f)
+				xdumpout(out, val_spec, val, 0);
+			else	xstreamout(out, val_spec, val, 0);
 			
-			if (fmt_c == 'S')	ss << "\"";
+			if (fmt_c == 'S')	out.push_back('"');
 		}	break;
 			
 		case 'd':
 		case 'i':
-		case 'u':					// used to be handled separately
+		case 'u':
+		case 'p':
 			
-			if (!number_f)			throw runtime_error("bad xsprintf() integer format");
-			xdump(val, ss);
+			xdumpout(out, spec, val, 0);
 			break;
 		
 		case 'X':
 			
-			if (!int_f)			throw runtime_error("bad xsprintf() integer format for upper-case hex");
-			ss << hex << uppercase;
-			xdump(val, ss);
+			xdumpout(out, spec, val, 2);
 			break;
 			
 		case 'x':
 			
-			if (!int_f)			throw runtime_error("bad xsprintf() integer format for (lower-case) hex");
-			ss << hex;
-			xdump(val, ss);
+			xdumpout(out, spec, val, 1);
 			break;
 		
-		case 'p':
-		{	// ptr
-			if (!ptr_f)			throw runtime_error("bad xsprintf() pointer format");
-			xdump(val, ss);
-		}	break;
-		
-		case 'g':
-		
-			// ss.precision(10);
+		default:	// floats
 		
-		case 'f':
-		case 'e':
-		case 'E':
-		case 'G':
-			
-			if (!number_f)			throw runtime_error("bad xsprintf() float or double format");
-			ss << val;
+			xstreamout(out, spec, val, 0);
 			break;
+	}
+}
 			
-		default:
-		{	// ERROR - unknown format flag
-			throw runtime_error("unhandled xsprintf() format flag");
-		}	break;
+// format ONE argument (consumes its format prefix)
+template<typename _T>
+void	xformatarg(const char *&s, const _T &val, xout &out)
+{
+	const xspec	spec = xhandleprefix(s/*&*/, out/*&*/);
+	
+	if (const char *err = xconverror<_T>(spec.m_Conv))
+		throw std::runtime_error(err);
+	
+	xformatconv(spec.m_Conv, val, spec, out);
+}
+
+// appends to out
+template<typename _T, typename ... Args>
+void	xformatto(xout &out, const char *s, const _T &val, const Args& ... args)
+{
+	xformatarg(s/*&*/, val, out);
+	
+	xformatto(out, s, args...);		// recurse with tail of arg list
+}
+
+// full vararg sprintf() re-implementation
+template<typename _T, typename ... Args>
+std::string	xsprintf(const char *s, const _T &val, Args&& ... args)
+{
+	std::string	res;
+	xout		out(res);
+	
+	xformatto(out, s, val, args...);
+	
+	return res;
+}
+
+//---- compile-time formats --------------------------------------------------
+
+	// "..."_fmt is parsed at compile time into literal chunks & conversion specs,
+	// argument count & types are checked by static_assert, so runtime just executes the plan
+	// formats with the same semantics as the runtime-parsed xsprintf()
+
+// number of conversions (i.e. args)
+constexpr
+size_t	xcountconv(const char *s)
+{
+	size_t	n = 0, i = 0;
+	
+	while (s[i])
+	{
+		if ('%' != s[i++])	continue;
+		
+		if (0 == s[i])		throw std::runtime_error("truncated format in xprintf()");
+		
+		if ('%' == s[i])
+		{	i++;
+			continue;
+		}
+		
+		xparsespec(s, i/*&*/);
+		n++;
 	}
 	
-	return ss.str() + xsprintf(s, std::forward<Args>(args) ...);	// recurse with tail of arg list
+	return n;
+}
+
+template<size_t _N, size_t _L>
+struct xplan
+{
+	xspec	m_Specs[_N + 1];
+	size_t	m_Chunks[_N + 2];		// literal chunk k is m_Lits[m_Chunks[k], m_Chunks[k + 1]), chunk _N trails
+	char	m_Lits[_L + 1];			// ("%%" unescaped)
+};
+
+template<size_t _N, size_t _L>
+constexpr
+xplan<_N, _L>	xbuildplan(const char *s)
+{
+	xplan<_N, _L>	plan{};
+	size_t		i = 0, n_lits = 0, n_conv = 0;
+	
+	while (s[i])
+	{
+		if (('%' != s[i]) || ('%' == s[i + 1]))
+		{	// vanilla char (or 1st of "%%")
+			plan.m_Lits[n_lits++] = s[i];
+			i += ('%' == s[i]) ? 2 : 1;
+			continue;
+		}
+		
+		i++;
+		plan.m_Specs[n_conv++] = xparsespec(s, i/*&*/);
+		plan.m_Chunks[n_conv] = n_lits;
+	}
+	
+	plan.m_Chunks[_N + 1] = n_lits;
+	
+	return plan;
+}
+
+template<char ... _Cs>
+struct xfmt
+{
+	static constexpr char		s_Str[sizeof...(_Cs) + 1] = {_Cs..., '\0'};
+	static constexpr size_t		NUM_CONV = xcountconv(s_Str);
+	static constexpr xplan<NUM_CONV, sizeof...(_Cs)>	s_Plan = xbuildplan<NUM_CONV, sizeof...(_Cs)>(s_Str);
+	
+	// (static storage, so is deferrable like a literal)
+	constexpr const char*	c_str(void) const	{return s_Str;}
+};
+
+template<char ... _Cs>	constexpr char		xfmt<_Cs...>::s_Str[sizeof...(_Cs) + 1];
+template<char ... _Cs>	constexpr size_t	xfmt<_Cs...>::NUM_CONV;
+template<char ... _Cs>	constexpr xplan<xfmt<_Cs...>::NUM_CONV, sizeof...(_Cs)>	xfmt<_Cs...>::s_Plan;
+
+template<typename _F, size_t _K>
+void	xrunchunk(xout &out)
+{
+	constexpr size_t	b = _F::s_Plan.m_Chunks[_K];
+	constexpr size_t	e = _F::s_Plan.m_Chunks[_K + 1];
+	
+	if (e > b)	out.append(&_F::s_Plan.m_Lits[b], e - b);
+}
+
+template<typename _F, size_t _K>
+void	xrunplan(xout &out)
+{
+	xrunchunk<_F, _K>(out);		// trailing chunk
+}
+
+template<typename _F, size_t _K, typename _T, typename ... Args>
+void	xrunplan(xout &out, const _T &val, const Args& ... args)
+{
+	constexpr xspec	spec = _F::s_Plan.m_Specs[_K];
+	
+	static_assert(nullptr == xconverror<_T>(spec.m_Conv), "xsprintf() argument type doesn't match its format conversion");
+	
+	xrunchunk<_F, _K>(out);
+	xformatconv(spec.m_Conv, val, spec, out);
+	
+	xrunplan<_F, _K + 1>(out, args...);
+}
+
+template<char ... _Cs, typename ... Args>
+void	xformatto(xout &out, xfmt<_Cs...>, const Args& ... args)
+{
+	using F = xfmt<_Cs...>;
+	
+	static_assert(F::NUM_CONV == sizeof...(Args), "xsprintf() argument count doesn't match format");
+	
+	xrunplan<F, 0>(out, args...);
+}
+	
+template<char ... _Cs, typename ... Args>
+std::string	xsprintf(xfmt<_Cs...> fmt, const Args& ... args)
+{
+	std::string	res;
+	xout		out(res);
+	
+	xformatto(out, fmt, args...);
+	
+	return res;
+}
+
+// string literal operator template is a GNU extension (g++ & clang)
+#if defined(__GNUC__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wpedantic"
+	#ifdef __clang__
+		#pragma clang diagnostic ignored "-Wgnu-string-literal-operator-template"
+	#endif
+	
+	template<typename _C, _C ... _Cs>
+	constexpr
+	xfmt<_Cs...>	operator "" _fmt()
+	{
+		static_assert(std::is_same<_C, char>::value, "_fmt only takes narrow strings");
+		
+		return {};
+	}
+	
+	#pragma GCC diagnostic pop
+#endif
+
+//---- deferred arguments -----------------------------------------------------
+
+	// type-tagged binary copy of xsprintf() arguments, so rendering can happen later/elsewhere
+	// only trivially copyable args (& strings, copied by value) can be deferred
+
+enum class XARG_T : std::uint8_t
+{
+	NONE = 0,		// not deferrable
+	BOOL,
+	CHAR,
+	I8,
+	U8,
+	I16,
+	U16,
+	I32,
+	U32,
+	I64,
+	U64,
+	F32,
+	F64,
+	F80,
+	STR,			// u16 length + chars
+	PTR,
+};
+
+template<typename _T>
+struct xarg_traits
+{
+	using T = typename std::decay<_T>::type;
+	
+	template<typename _I>
+	static constexpr
+	XARG_T	int_tag(void)
+	{
+		return	(sizeof(_I) == 1) ? (std::is_signed<_I>() ? XARG_T::I8 : XARG_T::U8) :
+			(sizeof(_I) == 2) ? (std::is_signed<_I>() ? XARG_T::I16 : XARG_T::U16) :
+			(sizeof(_I) == 4) ? (std::is_signed<_I>() ? XARG_T::I32 : XARG_T::U32) :
+			(sizeof(_I) == 8) ? (std::is_signed<_I>() ? XARG_T::I64 : XARG_T::U64) : XARG_T::NONE;
+	}
+	
+	template<typename _E>
+	static constexpr
+	XARG_T	enum_tag(std::true_type)	{return int_tag<typename std::underlying_type<_E>::type>();}
+	
+	template<typename _E>
+	static constexpr
+	XARG_T	enum_tag(std::false_type)	{return XARG_T::NONE;}
+	
+	static constexpr
+	XARG_T	tag(void)
+	{
+		return	std::is_same<T, bool>() ? XARG_T::BOOL :
+			std::is_same<T, char>() ? XARG_T::CHAR :
+			std::is_integral<T>() ? int_tag<T>() :
+			std::is_enum<T>() ? ((std::is_convertible<T, int>()) ? enum_tag<T>(std::is_enum<T>{}) : XARG_T::NONE) :
+			std::is_same<T, float>() ? XARG_T::F32 :
+			std::is_same<T, double>() ? XARG_T::F64 :
+			std::is_same<T, long double>() ? XARG_T::F80 :
+			(std::is_same<T, std::string>() || std::is_same<T, const char*>() || std::is_same<T, char*>()) ? XARG_T::STR :
+			std::is_pointer<T>() ? XARG_T::PTR : XARG_T::NONE;
+	}
+};
+
+template<typename ... Args>
+struct xargs_deferrable;
+
+template<>
+struct xargs_deferrable<> : std::true_type {};
+
+template<typename _T, typename ... Args>
+struct xargs_deferrable<_T, Args...> : std::integral_constant<bool, (xarg_traits<_T>::tag() != XARG_T::NONE) && xargs_deferrable<Args...>::value> {};
+
+// one packed (or in-place) value, see xargs::Next()
+struct xarg_view
+{
+	XARG_T		m_Tag;
+	const char	*m_Data;		// raw value bytes, or chars if STR
+	size_t		m_Size;
+	
+	template<typename _T>
+	_T	Get(void) const
+	{
+		_T	v;
+		
+		::memcpy(&v, m_Data, sizeof(v));
+		return v;
+	}
+	
+	// plain: integers as %d, floats as %g w/ (nearly) round-trip precision, bools as true/false,
+	// pointers as %p, chars & strings as is
+	void	Render(xout &out) const;
+};
+
+// view of a deferrable value in place (val must outlive it)
+template<typename _T>
+typename std::enable_if<(xarg_traits<_T>::tag() != XARG_T::STR) && (xarg_traits<_T>::tag() != XARG_T::NONE), xarg_view>::type
+	xargview(const _T &val)
+{
+	return xarg_view{xarg_traits<_T>::tag(), reinterpret_cast<const char*>(&val), sizeof(val)};
+}
+
+inline
+xarg_view	xargview(const char *s)
+{
+	return xarg_view{XARG_T::STR, s ? s : "", s ? ::strlen(s) : 0};
+}
+
+inline
+xarg_view	xargview(const std::string &s)
+{
+	return xarg_view{XARG_T::STR, s.data(), s.size()};
+}
+
+class xargs
+{
+public:
+	static constexpr size_t	MAX_BYTES = 240;
+	
+	xargs()
+		: m_Size(0)
+	{
+	}
+	
+	void		clear(void)		{m_Size = 0;}
+	bool		empty(void) const	{return 0 == m_Size;}
+	size_t		size(void) const	{return m_Size;}
+	const char*	data(void) const	{return m_Buff;}
+	
+	// from raw bytes as returned by data(), e.g. read back from a binary log
+	// returns false if too big or malformed
+	bool	assign(const char *p, const size_t n);
+	
+	// returns false on overflow (args should then be formatted on the spot)
+	template<typename ... Args>
+	bool	Pack(const Args& ... args)
+	{
+		clear();
+		
+		return PackTail(args...);
+	}
+	
+	// appends to already Pack()ed args, returns false on overflow (args are then partial)
+	template<typename ... Args>
+	bool	Append(const Args& ... args)
+	{
+		return PackTail(args...);
+	}
+	
+	// rendered with the same semantics as xsprintf(), args must have been Pack()ed
+	std::string	Render(const char *fmt) const;
+	void		Render(const char *fmt, xout &out) const;
+	
+	// walks packed args in order (pos starts at 0), returns false past the last one
+	bool	Next(size_t &pos, xarg_view &v) const;
+	
+private:
+	
+	bool	PackTail(void)	{return true;}
+	
+	template<typename _T, typename ... Args>
+	bool	PackTail(const _T &val, const Args& ... args)
+	{
+		return PackOne(val) && PackTail(args...);
+	}
+	
+	template<typename _T>
+	typename std::enable_if<xarg_traits<_T>::tag() != XARG_T::STR, bool>::type
+		PackOne(const _T &val)
+	{
+		using T = typename xarg_traits<_T>::T;
+		
+		const XARG_T	tag = xarg_traits<_T>::tag();
+		const T		v = val;
+		
+		return Put(tag, &v, sizeof(v));
+	}
+	
+	template<typename _T>
+	typename std::enable_if<xarg_traits<_T>::tag() == XARG_T::STR, bool>::type
+		PackOne(const _T &val)
+	{
+		return PutStr(val);
+	}
+	
+	bool	Put(const XARG_T tag, const void *p, const size_t sz);
+	bool	PutStr(const char *s);
+	bool	PutStr(const std::string &s);
+	bool	PutStr(const char *s, const size_t len);
+	
+	std::uint16_t	m_Size;
+	char		m_Buff[MAX_BYTES];
+};
+
+// render deferred args
+inline
+std::string	xsprintf(const char *s, const xargs &args)
+{
+	return args.Render(s);
+}
+
+inline
+void	xformatto(xout &out, const char *s, const xargs &args)
+{
+	args.Render(s, out);
+}
+
+//---- JSON string escape -----------------------------------------------------
+
+	// appends JSON string contents (w/o quotes): '"', '\\' & control chars are escaped,
+	// anything else (i.e. UTF-8) is copied as is; clean runs are scanned 16 bytes at a time on SSE2
+
+void	xputjson(xout &out, const char *p, const size_t n);
+
+//---- into caller storage ----------------------------------------------------
+
+	// fmt is a runtime format, a "..."_fmt or deferred xargs, with xsprintf() semantics (incl. exceptions)
+
+// into fixed buffer, truncated & NUL-terminated if size > 0
+// returns untruncated length (w/o NUL) like snprintf(), i.e. truncated if >= size
+template<typename _F, typename ... Args>
+size_t	xsnprintf(char *buff, const size_t size, const _F &fmt, const Args& ... args)
+{
+	xout	out(buff, size ? (size - 1) : 0);
+	
+	xformatto(out, fmt, args...);
+	
+	if (size)	buff[std::min(out.size(), size - 1)] = 0;
+	
+	return out.size();
+}
+
+template<size_t _N, typename _F, typename ... Args>
+typename std::enable_if<!std::is_integral<_F>::value, size_t>::type		// (not the size of above)
+	xsnprintf(char (&buff)[_N], const _F &fmt, const Args& ... args)
+{
+	return xsnprintf(&buff[0], _N, fmt, args...);
+}
+
+// appends to s (keeps its capacity), returns appended length
+template<typename _F, typename ... Args>
+size_t	xappendf(std::string &s, const _F &fmt, const Args& ... args)
+{
+	xout	out(s);
+	
+	xformatto(out, fmt, args...);
+	
+	return out.size();
+}
+
+// through output iterator, returns iterator past last char
+// renders on the stack first, only re-renders into a string if longer than that
+template<typename _OutIt, typename _F, typename ... Args>
+_OutIt	xformat_to(_OutIt it, const _F &fmt, const Args& ... args)
+{
+	char	buff[256];
+	xout	out(buff, sizeof(buff));
+	
+	xformatto(out, fmt, args...);
+	
+	if (out.size() <= sizeof(buff))
+		return std::copy(buff, buff + out.size(), it);
+	
+	std::string	res;
+	xout		res_out(res);
+	
+	xformatto(res_out, fmt, args...);
+	
+	return std::copy(res.begin(), res.end(), it);
 }
 
 } // namespace LX
@@ -52,17 +52,29 @@ enum class STAMP_FORMAT : uint32_t
 	MICROSEC	= (HMS | MS | US),
 };
 
+// enough for any timestamp_t::str() format
+constexpr size_t	STAMP_MAX_CHARS = 32;
+
 STAMP_FORMAT operator ~ (STAMP_FORMAT);				// useless?
 STAMP_FORMAT operator | (STAMP_FORMAT, STAMP_FORMAT);
 STAMP_FORMAT operator & (STAMP_FORMAT, STAMP_FORMAT);
 bool	operator!(STAMP_FORMAT);
 
+// timestamp clock source (process-wide)
+enum class STAMP_CLOCK : uint32_t
+{
+	SYSTEM = 0,			// std::chrono::system_clock (default), may jump on time adjustments
+	REALTIME_COARSE,		// CLOCK_REALTIME_COARSE, cheapest but kernel-tick resolution (Linux)
+	TSC,				// invariant TSC calibrated against the wall clock, re-anchored every second (x86)
+	MONOTONIC,			// steady clock + wall offset fixed when selected, never goes back
+};
+
 //---- Timestamp --------------------------------------------------------------
 
 class timestamp_t
 {
 	// using stampclock_t = std::chrono::steady_clock;			// won't get correct YEAR/MONTH/DAY/TZ
-	using stampclock_t = std::chrono::system_clock;				// may move back in time on system-time-adjust
+	using stampclock_t = std::chrono::system_clock;				// may move back in time on system-time-adjust (see STAMP_CLOCK)
 public:
 	using stamppoint_t = typename stampclock_t::time_point;
 	
@@ -79,6 +91,10 @@ public:
 	static timestamp_t	FromDUS(const int64_t &dus);
 	static timestamp_t	FromBigBang(void);
 	
+	// returns false if unavailable on this platform/CPU (current source is kept)
+	static bool		SetClock(const STAMP_CLOCK clk);
+	static STAMP_CLOCK	GetClock(void);
+	
 	bool		operator<(const timestamp_t &old_stamp) const;
 	bool		operator==(const timestamp_t &old_stamp) const;
 	timestamp_t	operator-(const timestamp_t &old_stamp) const;
@@ -103,6 +119,13 @@ public:
 
 	std::string	str(const STAMP_FORMAT fmt = STAMP_FORMAT::MILLISEC) const;
 
+	// into caller buffer (NUL-terminated, truncated if < STAMP_MAX_CHARS), returns length
+	// lock-free, thread-local cache of the current second's date/time
+	size_t		str(char *buff, const size_t buff_size, const STAMP_FORMAT fmt = STAMP_FORMAT::MILLISEC) const;
+	
+	// same, async-signal-safe (no tz lookup, local time uses the last offset any str() sampled)
+	size_t		crash_str(char *buff, const size_t buff_size, const STAMP_FORMAT fmt = STAMP_FORMAT::MILLISEC) const noexcept;
+
 	void		reset(void);		// (only non-const function)
 
 protected:
@@ -118,6 +141,14 @@ private:
 
 void	xtrap(const char *s = nullptr);
 
+// fatal signals (SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL) call hook once, then die as usual
+// hook must be async-signal-safe, returns false if unsupported (WIN32)
+bool	xtrap_fatal(void (*hook)(const int sig));
+
+// gives the calling thread its own alternate signal stack once xtrap_fatal() is installed, so
+// a stack overflow on it still runs the hook; cheap after the first call, false if none
+bool	xtrap_fatal_thread(void);
+
 } // namespace LX
 
 // nada mas
@@ -0,0 +1,547 @@
+// lx utils binary log slot & reader
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#ifdef WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+#include "lx/ulog.h"
+#include "lx/binlog.h"
+
+using namespace std;
+using namespace LX;
+
+//---- little-endian / varint helpers -----------------------------------------
+
+	// into a string, or a fixed stack buffer (xout) at crash time
+
+namespace
+{
+
+template<typename _Out>
+void	Put32(_Out &s, const uint32_t v)
+{
+	for (int i = 0; i < 4; i++)	s.push_back((char) (v >> (i * 8)));
+}
+
+template<typename _Out>
+void	Put64(_Out &s, const uint64_t v)
+{
+	for (int i = 0; i < 8; i++)	s.push_back((char) (v >> (i * 8)));
+}
+
+template<typename _Out>
+void	PutVarint(_Out &s, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		s.push_back((char) (v | 0x80));
+		v >>= 7;
+	}
+	
+	s.push_back((char) v);
+}
+
+uint64_t	ZigZag(const int64_t v)
+{
+	return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+int64_t		UnZigZag(const uint64_t v)
+{
+	return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+	// handles partial writes & signal interruptions (crash time, no stdio)
+
+bool	WriteAll(const int fd, const char *p, size_t n)
+{
+	while (n > 0)
+	{
+		#ifdef WIN32
+			const int	res = ::_write(fd, p, n);
+		#else
+			const ssize_t	res = ::write(fd, p, n);
+		#endif
+		
+		if (res < 0)
+		{
+			if (EINTR == errno)	continue;
+			
+			return false;
+		}
+		
+		p += res;
+		n -= res;
+	}
+	
+	return true;
+}
+
+	// bounds-checked cursor over a byte range
+
+class byte_reader
+{
+public:
+	byte_reader(const char *p, const size_t n)
+		: m_P((const uint8_t*) p), m_End((const uint8_t*) p + n), m_OK(true)
+	{
+	}
+	
+	bool	ok(void) const		{return m_OK;}
+	bool	eof(void) const		{return m_P >= m_End;}
+	
+	uint32_t	Get32(void)
+	{
+		if ((m_End - m_P) < 4)		return Fail();
+		
+		uint32_t	v = 0;
+		
+		for (int i = 0; i < 4; i++)	v |= (uint32_t) *m_P++ << (i * 8);
+		
+		return v;
+	}
+	
+	uint64_t	Get64(void)
+	{
+		if ((m_End - m_P) < 8)		return Fail();
+		
+		uint64_t	v = 0;
+		
+		for (int i = 0; i < 8; i++)	v |= (uint64_t) *m_P++ << (i * 8);
+		
+		return v;
+	}
+	
+	uint64_t	GetVarint(void)
+	{
+		uint64_t	v = 0;
+		
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (eof())	return Fail();
+			
+			const uint8_t	b = *m_P++;
+			
+			v |= (uint64_t) (b & 0x7f) << shift;
+			
+			if (!(b & 0x80))	return v;
+		}
+		
+		return Fail();
+	}
+	
+	const char*	GetBytes(const size_t n)
+	{
+		if ((size_t) (m_End - m_P) < n)
+		{	Fail();
+			return nil;
+		}
+		
+		const char	*p = (const char*) m_P;
+		m_P += n;
+		
+		return p;
+	}
+
+private:
+
+	uint64_t	Fail(void)
+	{
+		m_OK = false;
+		m_P = m_End;
+		return 0;
+	}
+	
+	const uint8_t	*m_P;
+	const uint8_t	*const m_End;
+	bool		m_OK;
+};
+
+} // anonymous namespace
+
+//---- Binary File Log --------------------------------------------------------
+
+	// no text formatting at all: stamp deltas, level hash, thread index & deferred format id + raw args
+	// (non-deferred records store their rendered text instead)
+	// blocks hit the disk when full, on FATAL/EXCEPTION/LX_ERROR, on close, and at crash time
+
+class BinaryFileLog : public LogSlot
+{
+public:
+	// ctor
+	BinaryFileLog(const string &fname, const size_t block_size)
+		: LogSlot{},
+		m_BlockSize(std::max<size_t>(block_size, 1024)),
+		m_File(::fopen(fname.c_str(), "wb")),
+		m_FD(m_File ? ::fileno(m_File) : -1),
+		m_LastUS(timestamp_t{}.GetUSecs()),
+		m_BaseUS(m_LastUS),
+		m_Count(0)
+	{
+		assert(m_File);
+		
+		m_Records.reserve(m_BlockSize + 512);
+		
+		string	hdr(BINLOG_MAGIC, sizeof(BINLOG_MAGIC));
+		
+		Put32(hdr, BINLOG_VERSION);
+		Put32(hdr, 0);				// flags
+		Put64(hdr, m_BaseUS);
+		
+		assert(BINLOG_HEADER_SIZE == hdr.size());
+		
+		if (!m_File)	return;
+		
+		::fwrite(hdr.data(), 1, hdr.size(), m_File);
+		::fflush(m_File);			// (so crash-time blocks never precede it)
+	}
+	// dtor
+	virtual ~BinaryFileLog()
+	{
+		DisconnectSelf();
+		
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		WriteBlock();
+		
+		if (m_File)	::fclose(m_File);
+	}
+	
+	// IMP
+	void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) override
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		Append(stamp, level, thread_id, 0, msg.data(), msg.size());
+	}
+	
+	void	LogRecordAtLevel(const LogRecord &rec) override
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		if (rec.m_Fmt)
+			Append(rec.m_Stamp, rec.m_Level, rec.m_ThreadIndex, FormatID(rec.m_Fmt), rec.m_Args.data(), rec.m_Args.size());
+		else
+		{	// (structured records as text)
+			const string	&msg = rec.Msg();
+			
+			Append(rec.m_Stamp, rec.m_Level, rec.m_ThreadIndex, 0, msg.data(), msg.size());
+		}
+	}
+	
+	// IMP: lock-free; written blocks were already fflush()ed, so only the pending one is
+	// write()n straight to the descriptor (one being written right now may come out twice)
+	bool	CrashFlush(void) override
+	{
+		if (m_FD < 0)	return false;
+		
+		const uint32_t	count = m_Count;
+		if (!count)	return true;
+		
+		const size_t	dict_bytes = m_Dict.size();
+		const size_t	rec_bytes = m_Records.size();
+		char		hdr[BINLOG_BLOCK_HEADER_SIZE];
+		xout		out(hdr, sizeof(hdr));
+		
+		PutBlockHeader(out, dict_bytes, rec_bytes, count, m_BaseUS);
+		
+		WriteAll(m_FD, hdr, sizeof(hdr));
+		WriteAll(m_FD, m_Dict.data(), dict_bytes);
+		WriteAll(m_FD, m_Records.data(), rec_bytes);
+		
+		return true;
+	}
+	
+	// one single-record block each, with the (raw) text
+	void	CrashLog(const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id) override
+	{
+		char	block[BINLOG_BLOCK_HEADER_SIZE + 32 + LogLine::CRASH_LINE_MAX];
+		xout	rec(block + BINLOG_BLOCK_HEADER_SIZE, sizeof(block) - BINLOG_BLOCK_HEADER_SIZE);
+		xout	hdr(block, BINLOG_BLOCK_HEADER_SIZE);
+		
+		PutRecord(rec, 0, level, thread_id, 0, msg, std::min(len, sizeof(block) - BINLOG_BLOCK_HEADER_SIZE - 32));
+		PutBlockHeader(hdr, 0, rec.size(), 1, stamp.GetUSecs());
+		
+		WriteAll(m_FD, block, BINLOG_BLOCK_HEADER_SIZE + rec.size());
+	}
+
+private:
+
+	template<typename _Out>
+	static
+	void	PutBlockHeader(_Out &out, const size_t dict_bytes, const size_t rec_bytes, const uint32_t count, const int64_t base_us)
+	{
+		out.append(BINLOG_BLOCK_MAGIC, sizeof(BINLOG_BLOCK_MAGIC));
+		
+		Put32(out, dict_bytes);
+		Put32(out, rec_bytes);
+		Put32(out, count);
+		Put64(out, base_us);
+	}
+	
+	template<typename _Out>
+	static
+	void	PutRecord(_Out &out, const int64_t delta_us, const LogLevel level, const size_t thread_id, const uint32_t fmt_id, const char *p, const size_t n)
+	{
+		PutVarint(out, ZigZag(delta_us));
+		Put32(out, level);
+		PutVarint(out, thread_id);
+		PutVarint(out, fmt_id);
+		PutVarint(out, n);
+		out.append(p, n);
+	}
+
+	// keyed by text, the pointer cache is only a shortcut that's checked against it
+	// (equal formats at different addresses share an ID, a reused buffer doesn't)
+	uint32_t	FormatID(const char *fmt)
+	{
+		const auto	it = m_FormatPtrs.find(fmt);
+		if ((m_FormatPtrs.end() != it) && !::strcmp(fmt, m_FormatTexts[it->second - 1]->c_str()))
+			return it->second;
+		
+		const auto	res = m_FormatIDs.emplace(string(fmt), m_FormatIDs.size() + 1);
+		const uint32_t	id = res.first->second;
+		
+		m_FormatPtrs[fmt] = id;
+		
+		if (!res.second)	return id;
+		
+		const string	&text = res.first->first;
+		
+		m_FormatTexts.push_back(&text);
+		
+		// defined in the block that first uses it
+		PutVarint(m_Dict, id);
+		PutVarint(m_Dict, text.size());
+		m_Dict.append(text);
+		
+		return id;
+	}
+	
+	void	Append(const timestamp_t stamp, const LogLevel level, const size_t thread_id, const uint32_t fmt_id, const char *p, const size_t n)
+	{
+		const int64_t	us = stamp.GetUSecs();
+		
+		PutRecord(m_Records, us - m_LastUS, level, thread_id, fmt_id, p, n);
+		
+		m_LastUS = us;
+		m_Count++;
+		
+		if ((m_Records.size() >= m_BlockSize) || (FATAL == level) || (EXCEPTION == level) || (LX_ERROR == level))
+			WriteBlock();
+	}
+	
+	void	WriteBlock(void)
+	{
+		if (!m_Count || !m_File)	return;
+		
+		string	hdr;
+		
+		PutBlockHeader(hdr, m_Dict.size(), m_Records.size(), m_Count, m_BaseUS);
+		
+		assert(BINLOG_BLOCK_HEADER_SIZE == hdr.size());
+		
+		::fwrite(hdr.data(), 1, hdr.size(), m_File);
+		::fwrite(m_Dict.data(), 1, m_Dict.size(), m_File);
+		::fwrite(m_Records.data(), 1, m_Records.size(), m_File);
+		::fflush(m_File);
+		
+		m_Dict.clear();
+		m_Records.clear();
+		m_Count = 0;
+		m_BaseUS = m_LastUS;
+	}
+	
+	const size_t		m_BlockSize;
+	FILE			*m_File;
+	const int		m_FD;			// (m_File's, for crash-time writes)
+	
+	mutable mutex		m_Mutex;
+	int64_t			m_LastUS;
+	int64_t			m_BaseUS;		// of current block
+	uint32_t		m_Count;
+	string			m_Dict;
+	string			m_Records;
+	unordered_map<string, uint32_t>		m_FormatIDs;
+	vector<const string*>			m_FormatTexts;		// by ID - 1 (map nodes are stable)
+	unordered_map<const char*, uint32_t>	m_FormatPtrs;
+};
+
+//---- instantiate ------------------------------------------------------------
+
+// static
+LogSlot*	LogSlot::CreateBinary(const string &fn, const size_t block_size)
+{
+	return new BinaryFileLog(fn, block_size);
+}
+
+//==== Binary Log Reader ======================================================
+
+	BinLogReader::BinLogReader(const string &fn)
+		: m_IFS(fn, ios_base::binary)
+{
+}
+
+bool	BinLogReader::Fail(const string &err)
+{
+	m_Error = err;
+	return false;
+}
+
+//---- Scan -------------------------------------------------------------------
+
+	// a truncated last block (crash) isn't an error, it's just dropped
+
+bool	BinLogReader::Scan(void)
+{
+	m_Formats.assign(1, string{});
+	m_Blocks.clear();
+	
+	if (!m_IFS)	return Fail("couldn't open file");
+	
+	char	hdr[BINLOG_HEADER_SIZE];
+	
+	if (!m_IFS.read(hdr, sizeof(hdr)) || ::memcmp(hdr, BINLOG_MAGIC, sizeof(BINLOG_MAGIC)))
+		return Fail("not a binary log");
+	
+	byte_reader	hdr_rd(hdr + sizeof(BINLOG_MAGIC), sizeof(hdr) - sizeof(BINLOG_MAGIC));
+	
+	const uint32_t	version = hdr_rd.Get32();
+	
+	if (BINLOG_VERSION != version)		return Fail(xsprintf("unsupported version %u", version));
+	
+	m_IFS.seekg(0, ios_base::end);
+	const uint64_t	file_size = m_IFS.tellg();
+	
+	uint64_t	pos = BINLOG_HEADER_SIZE;
+	string		dict;
+	
+	while ((pos + BINLOG_BLOCK_HEADER_SIZE) <= file_size)
+	{
+		char	blk_hdr[BINLOG_BLOCK_HEADER_SIZE];
+		
+		m_IFS.seekg(pos);
+		
+		if (!m_IFS.read(blk_hdr, sizeof(blk_hdr)))	break;
+		
+		if (::memcmp(blk_hdr, BINLOG_BLOCK_MAGIC, sizeof(BINLOG_BLOCK_MAGIC)))
+			return Fail(xsprintf("bad block header at offset %zu", (size_t) pos));
+		
+		byte_reader	rd(blk_hdr + sizeof(BINLOG_BLOCK_MAGIC), sizeof(blk_hdr) - sizeof(BINLOG_BLOCK_MAGIC));
+		
+		const uint32_t	dict_bytes = rd.Get32();
+		
+		binlog_block	blk;
+		
+		blk.m_RecBytes = rd.Get32();
+		blk.m_Count = rd.Get32();
+		blk.m_BaseUS = rd.Get64();
+		blk.m_Offset = pos + BINLOG_BLOCK_HEADER_SIZE + dict_bytes;
+		
+		if ((blk.m_Offset + blk.m_RecBytes) > file_size)	break;		// truncated
+		
+		// dictionary
+		dict.resize(dict_bytes);
+		
+		if (!m_IFS.read(&dict[0], dict_bytes))		break;
+		
+		byte_reader	dict_rd(dict.data(), dict.size());
+		
+		while (!dict_rd.eof())
+		{
+			const uint64_t	id = dict_rd.GetVarint();
+			const uint64_t	len = dict_rd.GetVarint();
+			const char	*p = dict_rd.GetBytes(len);
+			
+			if (!dict_rd.ok() || (0 == id) || (id > (1u << 24)))
+				return Fail(xsprintf("corrupt dictionary at offset %zu", (size_t) pos));
+			
+			if (id >= m_Formats.size())	m_Formats.resize(id + 1);
+			
+			m_Formats[id].assign(p, len);
+		}
+		
+		m_Blocks.push_back(blk);
+		
+		pos = blk.m_Offset + blk.m_RecBytes;
+	}
+	
+	m_IFS.clear();
+	
+	return true;
+}
+
+//---- Read Block (sequential) ------------------------------------------------
+
+bool	BinLogReader::ReadBlock(const binlog_block &blk, string &bytes)
+{
+	bytes.resize(blk.m_RecBytes);
+	
+	m_IFS.seekg(blk.m_Offset);
+	
+	if (!m_IFS.read(&bytes[0], blk.m_RecBytes))	return Fail("read error");
+	
+	return true;
+}
+
+//---- Render Block (thread-safe) ---------------------------------------------
+
+bool	BinLogReader::RenderBlock(const binlog_block &blk, const string &bytes, const STAMP_FORMAT fmt, const double min_elap_secs, string &out) const
+{
+	LogLine		line_composer(fmt, min_elap_secs);
+	byte_reader	rd(bytes.data(), bytes.size());
+	int64_t		us = blk.m_BaseUS;
+	xargs		args;
+	string		msg;
+	
+	line_composer.SetLastStamp(timestamp_t::FromUS(us));
+	
+	for (uint32_t i = 0; i < blk.m_Count; i++)
+	{
+		us += UnZigZag(rd.GetVarint());
+		
+		const LogLevel	level = rd.Get32();
+		const size_t	thread_id = rd.GetVarint();
+		const uint64_t	fmt_id = rd.GetVarint();
+		const uint64_t	len = rd.GetVarint();
+		const char	*p = rd.GetBytes(len);
+		
+		if (!rd.ok())		return false;
+		
+		if (0 == fmt_id)
+			msg.assign(p, len);
+		else if ((fmt_id >= m_Formats.size()) || m_Formats[fmt_id].empty())
+			msg = xsprintf("<unknown format id %zu>", (size_t) fmt_id);
+		else if (!args.assign(p, len))
+			msg = "<corrupt args> " + m_Formats[fmt_id];
+		else
+		{
+			try
+			{
+				msg = args.Render(m_Formats[fmt_id].c_str());
+			}
+			catch (std::runtime_error &e)
+			{
+				msg = string(e.what()) + " in format \"" + m_Formats[fmt_id] + "\"";
+			}
+		}
+		
+		line_composer.Compose(out, timestamp_t::FromUS(us), level, msg, thread_id);
+	}
+	
+	return true;
+}
+
+// nada mas
@@ -0,0 +1,982 @@
+// lx utils buffered file log
+
+#include <cassert>
+#include <cerrno>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include <sys/stat.h>
+
+#ifdef WIN32
+	#include <io.h>
+	#include <fcntl.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <dirent.h>
+	#include <sys/uio.h>
+	#include <sys/resource.h>
+	#ifdef __linux__
+		#include <sys/syscall.h>
+	#endif
+#endif
+
+#include "lx/ulog.h"
+#include "lx/xcodec.h"
+#include "lx/logindex.h"
+
+using namespace std;
+using namespace LX;
+
+//---- low-level file I/O -----------------------------------------------------
+
+static
+int	OpenTrunc(const string &fn)
+{
+	#ifdef WIN32
+		return ::_open(fn.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+	#else
+		return ::open(fn.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	#endif
+}
+
+static
+bool	FileExists(const string &fn)
+{
+	#ifdef WIN32
+		struct _stat	st;
+		return (0 == ::_stat(fn.c_str(), &st));
+	#else
+		struct stat	st;
+		return (0 == ::stat(fn.c_str(), &st));
+	#endif
+}
+
+static
+size_t	FileSize(const string &fn)
+{
+	#ifdef WIN32
+		struct _stat	st;
+		return (0 == ::_stat(fn.c_str(), &st)) ? st.st_size : 0;
+	#else
+		struct stat	st;
+		return (0 == ::stat(fn.c_str(), &st)) ? st.st_size : 0;
+	#endif
+}
+
+static
+void	CloseFile(const int fd)
+{
+	if (fd < 0)	return;
+	
+	#ifdef WIN32
+		::_close(fd);
+	#else
+		::close(fd);
+	#endif
+}
+
+	// handles partial writes & signal interruptions
+
+static
+bool	WriteAll(const int fd, const char *p, size_t n)
+{
+	while (n > 0)
+	{
+		#ifdef WIN32
+			const int	res = ::_write(fd, p, n);
+		#else
+			const ssize_t	res = ::write(fd, p, n);
+		#endif
+		
+		if (res < 0)
+		{
+			if (EINTR == errno)	continue;
+			
+			return false;
+		}
+		
+		p += res;
+		n -= res;
+	}
+	
+	return true;
+}
+
+	// buffer + oversized tail in ONE syscall (gathered write)
+
+static
+bool	WriteAll(const int fd, const string &s0, const string &s1)
+{
+	#ifdef WIN32
+		return WriteAll(fd, s0.data(), s0.size()) && WriteAll(fd, s1.data(), s1.size());
+	#else
+		iovec	iov[2] = {{(void*) s0.data(), s0.size()}, {(void*) s1.data(), s1.size()}};
+		
+		const ssize_t	res = ::writev(fd, iov, 2);
+		if ((res < 0) && (EINTR != errno))	return false;
+		
+		// finish short write piecemeal
+		const size_t	done = (res > 0) ? res : 0;
+		
+		if (done < s0.size())
+			return WriteAll(fd, s0.data() + done, s0.size() - done) && WriteAll(fd, s1.data(), s1.size());
+		else	return WriteAll(fd, s1.data() + (done - s0.size()), s1.size() - (done - s0.size()));
+	#endif
+}
+
+//---- append hex w/o iostream manipulators -----------------------------------
+
+static
+void	AppendHex(xout &s, uint64_t v, const int min_digits)
+{
+	static const char	s_HexDigits[] = "0123456789abcdef";
+	
+	char	buff[16];
+	int	n = 0;
+	
+	do
+	{	buff[n++] = s_HexDigits[v & 0x0f];
+		v >>= 4;
+	} while (v);
+	
+	while (n < min_digits)	buff[n++] = '0';
+	
+	while (n > 0)	s.push_back(buff[--n]);
+}
+
+//---- Log Line ---------------------------------------------------------------
+
+	LogLine::LogLine(const STAMP_FORMAT fmt, const double min_elap_secs)
+		: m_Fmt(fmt),
+		m_MinSepElapSecs(min_elap_secs),
+		m_HexLevelFlag((fmt | STAMP_FORMAT::LEVEL) == fmt)
+{
+}
+
+void	LogLine::Compose(string &s, const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id)
+{
+	xout	out(s);
+	
+	Compose(out, stamp, level, msg.data(), msg.size(), thread_id, false);
+}
+
+size_t	LogLine::CrashCompose(char *buff, const size_t buff_size, const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id)
+{
+	if (0 == buff_size)	return 0;
+	
+	xout	out(buff, buff_size);
+	
+	Compose(out, stamp, level, msg, len, thread_id, true);
+	
+	if (out.size() <= buff_size)	return out.size();
+	
+	// truncated
+	buff[buff_size - 1] = '\n';
+	return buff_size;
+}
+
+void	LogLine::Compose(xout &s, const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id, const bool crash_f)
+{
+	const double	delta_secs = std::min(stamp.delta_secs(m_LastStamp), 80.0);
+	m_LastStamp = stamp;
+	
+	if (delta_secs > m_MinSepElapSecs)
+	{
+		s.append((size_t)delta_secs, '-');
+		s.push_back('\n');
+	}
+	
+	char	stamp_s[STAMP_MAX_CHARS];
+	
+	s.append(stamp_s, crash_f ? stamp.crash_str(stamp_s, sizeof(stamp_s), m_Fmt) : stamp.str(stamp_s, sizeof(stamp_s), m_Fmt));
+	
+	if (m_HexLevelFlag)
+	{
+		s.push_back('|');
+		AppendHex(s, level, 8);
+		s.push_back('|');
+	}
+	
+	if (thread_id > 0)
+	{	// OFF-THREAD
+		s.append(" _THREAD ", 9);
+		AppendHex(s, thread_id, 1);
+		s.append(" : ", 3);
+	}
+	else	s.push_back(' ');
+	
+	s.append(msg, len);
+	s.push_back('\n');
+}
+
+//---- Log Rotator ------------------------------------------------------------
+
+	// rotated files are named <fn>.<UTC yyyymmdd-hhmmss>[-N][.lz]
+	// the writer's switch is two renames + swapping in a PRE-OPENED fd (<fn>.next),
+	// compression & pruning happen on a low-priority background thread
+
+class LogRotator
+{
+	struct rotated_entry
+	{
+		string	m_Name;
+		string	m_Key;			// sorts chronologically
+		bool	m_Packed;
+		bool	m_Temp;			// interrupted compression
+	};
+
+public:
+	// ctor
+	LogRotator(const string &fname, const LogRotation &rotation)
+		: m_FileName(fname),
+		m_NextName(fname + ".next"),
+		m_Keep(rotation.m_Keep),
+		m_CompressFlag(rotation.m_Compress),
+		m_NextFD(-1),
+		m_ExitFlag(false)
+	{
+		const size_t	slash = fname.find_last_of("/\\");
+		
+		m_Dir = (string::npos == slash) ? string("./") : fname.substr(0, slash + 1);
+		m_Prefix = ((string::npos == slash) ? fname : fname.substr(slash + 1)) + ".";
+		
+		// previous run's leftovers
+		for (const auto &e : ListRotated())
+		{
+			if (e.m_Temp)
+				::remove((m_Dir + e.m_Name).c_str());
+			else if (!e.m_Packed && m_CompressFlag)
+				m_Pending.push_back(m_Dir + e.m_Name);
+		}
+		
+		m_Thread = thread(&LogRotator::Run, this);
+	}
+	// dtor
+	~LogRotator()
+	{
+		{	unique_lock<mutex>	locker(m_Mutex);
+		
+			m_ExitFlag = true;
+		}
+		
+		m_Cond.notify_one();
+		m_Thread.join();
+		
+		if (m_NextFD >= 0)
+		{
+			CloseFile(m_NextFD);
+			::remove(m_NextName.c_str());
+		}
+	}
+	
+	// moves previous run's file aside instead of truncating it, returns fd
+	int	OpenInitial(void)
+	{
+		if (FileSize(m_FileName) > 0)
+		{
+			unique_lock<mutex>	locker(m_Mutex);
+			
+			const string	rotated = RotatedName();
+			
+			if (0 == ::rename(m_FileName.c_str(), rotated.c_str()))
+				m_Pending.push_back(rotated);
+		}
+		
+		m_Cond.notify_one();
+		
+		return OpenTrunc(m_FileName);
+	}
+	
+	// (caller serializes writes, never with the producers' mutex held) returns fd of fresh file,
+	// old fd is closed; if the background thread hasn't pre-opened <fn>.next yet, the writer
+	// opens the new file itself, which only stalls producers if their buffer fills meanwhile
+	int	Rotate(const int old_fd)
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		#ifdef WIN32
+			CloseFile(old_fd);		// (can't rename open files)
+		#endif
+		
+		const string	rotated = RotatedName();
+		
+		const bool	moved_ok = (0 == ::rename(m_FileName.c_str(), rotated.c_str()));
+		
+		int	fd = m_NextFD;
+		m_NextFD = -1;
+		
+		if (moved_ok && (fd >= 0) && (0 == ::rename(m_NextName.c_str(), m_FileName.c_str())))
+		{	// hand-off
+		}
+		else
+		{	// next wasn't ready (or rename failed), open synchronously
+			CloseFile(fd);
+			
+			fd = moved_ok ? OpenTrunc(m_FileName) : OpenAppend(m_FileName);
+		}
+		
+		if (moved_ok)	m_Pending.push_back(rotated);
+		
+		locker.unlock();
+		
+		m_Cond.notify_one();
+		
+		#ifndef WIN32
+			CloseFile(old_fd);
+		#endif
+		
+		return fd;
+	}
+
+private:
+
+	static
+	int	OpenAppend(const string &fn)
+	{
+		#ifdef WIN32
+			return ::_open(fn.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, 0644);
+		#else
+			return ::open(fn.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		#endif
+	}
+	
+	// (m_Mutex held) unique within this run
+	string	RotatedName(void) const
+	{
+		const time_t	now = ::time(nil);
+		struct tm	tm_utc;
+		
+		#ifdef WIN32
+			::gmtime_s(&tm_utc, &now);
+		#else
+			::gmtime_r(&now, &tm_utc);
+		#endif
+		
+		char	stamp[32];
+		
+		::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_utc);
+		
+		const string	base = m_FileName + "." + stamp;
+		string		fn = base;
+		
+		for (int i = 1; FileExists(fn) || FileExists(fn + ".lz"); i++)
+			fn = base + "-" + to_string(i);
+		
+		return fn;
+	}
+	
+	// <prefix>yyyymmdd-hhmmss[-N][.lz[.tmp]]
+	bool	ParseRotated(const string &name, rotated_entry &e) const
+	{
+		if (name.compare(0, m_Prefix.size(), m_Prefix))		return false;
+		
+		size_t	i = m_Prefix.size();
+		
+		if (name.size() < (i + 15))	return false;
+		
+		for (size_t j = 0; j < 15; j++)
+		{
+			const char	c = name[i + j];
+			
+			if ((8 == j) ? ('-' != c) : !isdigit((unsigned char)c))	return false;
+		}
+		
+		const string	stamp = name.substr(i, 15);
+		i += 15;
+		
+		unsigned long	suffix = 0;
+		
+		if ((i < name.size()) && ('-' == name[i]) && ((i + 1) < name.size()) && isdigit((unsigned char)name[i + 1]))
+		{
+			i++;
+			
+			while ((i < name.size()) && isdigit((unsigned char)name[i]))	suffix = (suffix * 10) + (name[i++] - '0');
+		}
+		
+		const string	ext = name.substr(i);
+		
+		if (!ext.empty() && (".lz" != ext) && (".lz.tmp" != ext))	return false;
+		
+		char	key_buff[64];
+		
+		snprintf(key_buff, sizeof(key_buff), "%s-%08lu", stamp.c_str(), suffix);
+		
+		e.m_Name = name;
+		e.m_Key = key_buff;
+		e.m_Packed = (".lz" == ext);
+		e.m_Temp = (".lz.tmp" == ext);
+		
+		return true;
+	}
+	
+	vector<rotated_entry>	ListRotated(void) const
+	{
+		vector<rotated_entry>	res;
+		rotated_entry		e;
+		
+		#ifdef WIN32
+			_finddata_t	fd;
+			
+			const intptr_t	h = ::_findfirst((m_Dir + m_Prefix + "*").c_str(), &fd);
+			if (-1 == h)	return res;
+			
+			do
+			{	if (ParseRotated(fd.name, e))	res.push_back(e);
+			} while (0 == ::_findnext(h, &fd));
+			
+			::_findclose(h);
+		#else
+			DIR	*dir = ::opendir(m_Dir.c_str());
+			if (!dir)	return res;
+			
+			while (const dirent *ent = ::readdir(dir))
+			{
+				if (ParseRotated(ent->d_name, e))	res.push_back(e);
+			}
+			
+			::closedir(dir);
+		#endif
+		
+		return res;
+	}
+	
+	void	Compress(const string &fn)
+	{
+		if (!FileExists(fn))	return;			// (pruned already)
+		
+		const string	packed = fn + ".lz";
+		const string	temp = packed + ".tmp";
+		
+		// rename when complete so a crash never leaves a truncated .lz
+		if (LZCompressFile(fn, temp) && (0 == ::rename(temp.c_str(), packed.c_str())))
+			::remove(fn.c_str());
+		else	::remove(temp.c_str());
+	}
+	
+	// keep the newest N rotations (raw or packed)
+	void	Prune(void)
+	{
+		vector<rotated_entry>	entries = ListRotated();
+		
+		vector<string>	keys;
+		
+		for (const auto &e : entries)
+			if (!e.m_Temp)	keys.push_back(e.m_Key);
+		
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		
+		if (keys.size() <= m_Keep)	return;
+		
+		const string	&oldest_kept = keys[keys.size() - m_Keep - 1];
+		
+		for (const auto &e : entries)
+		{
+			if (!e.m_Temp && (e.m_Key <= oldest_kept))
+				::remove((m_Dir + e.m_Name).c_str());
+		}
+	}
+	
+	void	Run(void)
+	{
+		// don't compete with the app
+		#ifdef __linux__
+			::setpriority(PRIO_PROCESS, (id_t) ::syscall(SYS_gettid), 19);
+		#endif
+		
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		for (;;)
+		{
+			// (under mutex so Rotate() never sees a half-created next file)
+			if ((m_NextFD < 0) && !m_ExitFlag)
+				m_NextFD = OpenTrunc(m_NextName);
+			
+			if (m_Pending.empty())
+			{
+				if (m_ExitFlag)		break;
+				
+				m_Cond.wait(locker);
+				continue;
+			}
+			
+			const string	fn = std::move(m_Pending.front());
+			m_Pending.pop_front();
+			
+			locker.unlock();
+			
+			if (m_CompressFlag)	Compress(fn);
+			
+			Prune();
+			
+			locker.lock();
+		}
+	}
+	
+	const string		m_FileName;
+	const string		m_NextName;
+	string			m_Dir;
+	string			m_Prefix;		// rotated file name prefix (w/o dir)
+	const size_t		m_Keep;
+	const bool		m_CompressFlag;
+	
+	mutex			m_Mutex;
+	condition_variable	m_Cond;
+	deque<string>		m_Pending;		// rotated, not yet compressed
+	int			m_NextFD;
+	bool			m_ExitFlag;
+	thread			m_Thread;
+};
+
+//---- Buffered File Log ------------------------------------------------------
+
+	// lines are composed into a large contiguous buffer which hits the disk with (gathered) write()s
+	// when full, per flush policy, or from a flusher thread every N ms
+	// double-buffered: the disk write happens OUTSIDE the producers' mutex
+	// optionally rotates by size / wall-clock interval, see LogRotator
+	// or keeps a sidecar time/level index (not both, offsets restart on rotation), see LogIndexWriter
+
+class BufferedFileLog : public LogSlot
+{
+public:
+	// ctor
+	BufferedFileLog(const string &fname, const FLUSH_POLICY policy, const int interval_ms, const STAMP_FORMAT fmt, const double min_elap_secs, const size_t buff_size, const LogRotation *rotation = nil, const LogIndexing *indexing = nil)
+		: LogSlot{},
+		m_LineComposer(fmt, min_elap_secs),
+		m_Policy(policy),
+		m_IntervalMS(std::max(interval_ms, 1)),
+		m_BuffSize(buff_size),
+		m_Rotation(rotation ? *rotation : LogRotation{}),
+		m_Rotator(rotation ? new LogRotator(fname, *rotation) : nil),
+		m_FD(m_Rotator ? m_Rotator->OpenInitial() : OpenTrunc(fname)),
+		m_Index((indexing && !rotation) ? new LogIndexWriter(fname, fmt, indexing->m_BlockBytes) : nil),
+		m_Written(0),
+		m_RotateDeadline(NextDeadline()),
+		m_ExitFlag(false)
+	{
+		assert(m_FD >= 0);
+		
+		m_Buff.reserve(m_BuffSize);
+		m_Back.reserve(m_BuffSize);
+		
+		if (FLUSH_POLICY::INTERVAL == m_Policy)
+			m_FlushThread = thread(&BufferedFileLog::FlushLoop, this);
+	}
+	// dtor
+	virtual ~BufferedFileLog()
+	{
+		DisconnectSelf();
+		
+		if (m_FlushThread.joinable())
+		{
+			{	unique_lock<mutex>	locker(m_Mutex);
+			
+				m_ExitFlag = true;
+			}
+			
+			m_FlushCond.notify_one();
+			m_FlushThread.join();
+		}
+		
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		FlushLocked(locker);
+		
+		if (m_Index)
+		{	// short last block
+			m_Index->CloseBlock();
+			m_Index->TakeEntries(m_IndexBack);
+			m_Index->WriteEntries(m_IndexBack);
+		}
+		
+		CloseFile(m_FD);
+	}
+	
+	// IMP
+	void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) override
+	{
+		AppendLine(stamp, level, [&](string &line){m_LineComposer.Compose(line, stamp, level, msg, thread_id);});
+	}
+	
+	// IMP: lock-free, neither buffer ever reallocates (reserved to m_BuffSize, flushed before growing)
+	// a non-empty back buffer hasn't fully hit the disk yet, so may come out twice
+	bool	CrashFlush(void) override
+	{
+		if (m_FD < 0)	return false;
+		
+		WriteAll(m_FD, m_Back.data(), m_Back.size());
+		WriteAll(m_FD, m_Buff.data(), m_Buff.size());
+		
+		return true;
+	}
+	
+	void	CrashLog(const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id) override
+	{
+		char	line[LogLine::CRASH_LINE_MAX];
+		
+		CrashWrite(line, m_LineComposer.CrashCompose(line, sizeof(line), stamp, level, msg, len, thread_id));
+	}
+
+protected:
+	
+	// line is composed under mutex (into reused buffer), then buffered per flush policy
+	template<typename _Compose>
+	void	AppendLine(const timestamp_t stamp, const LogLevel level, _Compose compose)
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		m_Line.clear();
+		
+		compose(m_Line);
+		
+		const line_tail	tail{&m_Line, stamp.GetUSecs(), level};
+		
+		if ((m_Buff.size() + m_Line.size()) > m_BuffSize)
+		{	// full: flush buffer, line starts the next one
+			FlushLocked(locker, &tail);
+		}
+		else	AppendFront(tail);
+		
+		switch (m_Policy)
+		{
+			case FLUSH_POLICY::LINE:
+			
+				FlushLocked(locker);
+				break;
+			
+			case FLUSH_POLICY::ERRORS:
+			
+				if ((FATAL == level) || (EXCEPTION == level) || (LX_ERROR == level))
+					FlushLocked(locker);
+				break;
+			
+			default:
+			
+				// (flusher thread)
+				break;
+		}
+	}
+
+	// (crash time only, see CrashFlush)
+	void	CrashWrite(const char *p, const size_t n)
+	{
+		WriteAll(m_FD, p, n);
+	}
+
+private:
+
+	// composed line & what the index needs of it
+	struct line_tail
+	{
+		const string	*m_Line;
+		int64_t		m_US;
+		LogLevel	m_Level;
+	};
+	
+	// (caller holds m_Mutex, lines hit the file in this order)
+	void	AppendFront(const line_tail &tail)
+	{
+		if (m_Index)	m_Index->AddLine(tail.m_Line->size(), tail.m_US, tail.m_Level);
+		
+		m_Buff.append(*tail.m_Line);
+	}
+	
+	//---- Flush (caller holds m_Mutex, is released during disk write) ------------
+	
+	// tail is a line that didn't fit: it starts the emptied front buffer, unless it's longer than
+	// a whole buffer (which never reallocates), then a copy is written right behind the back one
+	void	FlushLocked(unique_lock<mutex> &locker, const line_tail *tail = nil)
+	{
+		if (m_Buff.empty() && !tail)	return;
+		
+		// serialize writers so file order is kept
+		unique_lock<mutex>	write_locker(m_WriteMutex);
+		
+		m_Buff.swap(m_Back);
+		
+		// closed index blocks are all in this write, their entries follow it
+		if (m_Index)	m_Index->TakeEntries(m_IndexBack);
+		
+		string	oversize;
+		
+		if (tail && (tail->m_Line->size() > m_BuffSize))
+		{
+			if (m_Index)	m_Index->AddLine(tail->m_Line->size(), tail->m_US, tail->m_Level);
+			
+			oversize = *tail->m_Line;
+		}
+		else if (tail)	AppendFront(*tail);
+		
+		// disk write & rotation without blocking producers
+		locker.unlock();
+		
+		CheckRotation(m_Back.size() + oversize.size());
+		
+		const bool	ok = WriteAll(m_FD, m_Back, oversize);
+		assert(ok);
+		(void)ok;
+		
+		m_Written += m_Back.size() + oversize.size();
+		m_Back.clear();			// (keeps capacity)
+		
+		if (m_Index)	m_Index->WriteEntries(m_IndexBack);
+		
+		write_locker.unlock();
+		locker.lock();
+	}
+	
+	//---- Rotation (caller holds m_WriteMutex, NOT m_Mutex) ----------------------
+	
+	// rotation lands between flushed buffers, so files only ever hold whole lines
+	void	CheckRotation(const size_t pending)
+	{
+		if (!m_Rotator || (0 == pending))	return;
+		
+		const bool	size_due = (m_Rotation.m_MaxBytes > 0) && (m_Written + pending > m_Rotation.m_MaxBytes);
+		const bool	time_due = (m_Rotation.m_IntervalSecs > 0) && (::time(nil) >= m_RotateDeadline);
+		
+		if (time_due)	m_RotateDeadline = NextDeadline();
+		
+		if ((!size_due && !time_due) || (0 == m_Written))	return;		// (never rotate an empty file)
+		
+		m_FD = m_Rotator->Rotate(m_FD);
+		assert(m_FD >= 0);
+		
+		m_Written = 0;
+	}
+	
+	time_t	NextDeadline(void) const
+	{
+		const time_t	secs = m_Rotation.m_IntervalSecs;
+		if (secs <= 0)		return 0;
+		
+		return ((::time(nil) / secs) + 1) * secs;
+	}
+	
+	void	FlushLoop(void)
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		while (!m_ExitFlag)
+		{
+			m_FlushCond.wait_for(locker, chrono::milliseconds(m_IntervalMS));
+			
+			FlushLocked(locker);
+		}
+	}
+	
+	LogLine			m_LineComposer;
+	const FLUSH_POLICY	m_Policy;
+	const int		m_IntervalMS;
+	const size_t		m_BuffSize;
+	const LogRotation	m_Rotation;
+	unique_ptr<LogRotator>	m_Rotator;		// nil if not rotating
+	int			m_FD;
+	unique_ptr<LogIndexWriter>	m_Index;		// nil if not indexing
+	string			m_IndexBack;		// (under m_WriteMutex)
+	size_t			m_Written;		// into current file
+	time_t			m_RotateDeadline;
+	
+	mutable mutex		m_Mutex;
+	mutable mutex		m_WriteMutex;
+	condition_variable	m_FlushCond;
+	thread			m_FlushThread;
+	bool			m_ExitFlag;
+	
+	string			m_Buff;			// front (producers)
+	string			m_Back;			// being written
+	string			m_Line;
+};
+
+//---- JSON Lines File Log -----------------------------------------------------
+
+	// one object per line, buffered/flushed like the text file log:
+	//   {"ts":<epoch us>,"level":"<hex>","thread":<index>[,"site":"<file>:<line>"],"msg":"..."[,"<key>":<value>...]}
+	// structured records (uLogKV) are written from their packed values without going through text,
+	// numbers & bools as JSON literals (non-finite floats as null), chars, strings & pointers as strings
+
+static
+void	PutJSONValue(xout &out, const xarg_view &v)
+{
+	switch (v.m_Tag)
+	{
+		case XARG_T::F32:
+		case XARG_T::F64:
+		case XARG_T::F80:
+		{
+			const double	d = (XARG_T::F32 == v.m_Tag) ? v.Get<float>() : (XARG_T::F64 == v.m_Tag) ? v.Get<double>() : (double) v.Get<long double>();
+			
+			if (std::isfinite(d))
+				v.Render(out);
+			else	out.append("null", 4);
+		}	break;
+		
+		case XARG_T::CHAR:
+		case XARG_T::STR:
+		
+			out.push_back('"');
+			xputjson(out, v.m_Data, v.m_Size);
+			out.push_back('"');
+			break;
+		
+		case XARG_T::PTR:
+		
+			out.push_back('"');
+			v.Render(out);
+			out.push_back('"');
+			break;
+		
+		default:
+		
+			v.Render(out);
+			break;
+	}
+}
+
+	// fields (if any) are walked from pos, i.e. past the message
+
+static
+void	ComposeJSON(xout &out, const timestamp_t stamp, const LogLevel level, const size_t thread_id, const LogSite *site, const char *msg, const size_t len, const xargs *fields = nil, size_t pos = 0)
+{
+	const xspec	spec{'d', false, 0, 0, -1};
+	
+	out.append("{\"ts\":", 6);
+	xstreamout(out, spec, stamp.GetUSecs(), 0);
+	out.append(",\"level\":\"", 10);
+	AppendHex(out, level, 8);
+	out.append("\",\"thread\":", 11);
+	xstreamout(out, spec, thread_id, 0);
+	
+	if (site)
+	{
+		out.append(",\"site\":\"", 9);
+		xputjson(out, site->m_File, ::strlen(site->m_File));
+		out.push_back(':');
+		xstreamout(out, spec, site->m_Line, 0);
+		out.push_back('"');
+	}
+	
+	out.append(",\"msg\":\"", 8);
+	xputjson(out, msg, len);
+	out.push_back('"');
+	
+	xarg_view	key, val;
+	
+	while (fields && fields->Next(pos, key) && fields->Next(pos, val))
+	{
+		out.append(",\"", 2);
+		xputjson(out, key.m_Data, key.m_Size);
+		out.append("\":", 2);
+		PutJSONValue(out, val);
+	}
+	
+	out.append("}\n", 2);
+}
+
+class JSONFileLog : public BufferedFileLog
+{
+public:
+	// ctor
+	JSONFileLog(const string &fname, const FLUSH_POLICY policy, const int interval_ms, const size_t buff_size)
+		: BufferedFileLog(fname, policy, interval_ms, STAMP_FORMAT::MILLISEC, 0, buff_size)
+	{
+	}
+	// dtor
+	virtual ~JSONFileLog()
+	{
+		DisconnectSelf();
+	}
+	
+	// IMP: text record
+	void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) override
+	{
+		AppendLine(stamp, level, [&](string &line)
+		{
+			xout	out(line);
+			
+			ComposeJSON(out, stamp, level, thread_id, nil, msg.data(), msg.size());
+		});
+	}
+	
+	// IMP: deferred records are rendered, structured ones written as is
+	void	LogRecordAtLevel(const LogRecord &rec) override
+	{
+		size_t		pos = 0;
+		xarg_view	msg;
+		
+		if (!rec.m_FieldsFlag || !rec.m_Args.Next(pos, msg))
+		{
+			const string	&text = rec.Msg();
+			
+			msg = xarg_view{XARG_T::STR, text.data(), text.size()};
+		}
+		
+		AppendLine(rec.m_Stamp, rec.m_Level, [&](string &line)
+		{
+			xout	out(line);
+			
+			ComposeJSON(out, rec.m_Stamp, rec.m_Level, rec.m_ThreadIndex, rec.m_Site, msg.m_Data, msg.m_Size, rec.m_FieldsFlag ? &rec.m_Args : nil, pos);
+		});
+	}
+	
+	// IMP: (over-long message is cut so the line stays valid JSON)
+	void	CrashLog(const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id) override
+	{
+		char	line[LogLine::CRASH_LINE_MAX];
+		
+		for (size_t n = len; ; n /= 2)
+		{
+			xout	out(line, sizeof(line));
+			
+			ComposeJSON(out, stamp, level, thread_id, nil, msg, n);
+			
+			if (out.size() <= sizeof(line))
+			{	CrashWrite(line, out.size());
+				break;
+			}
+			
+			if (0 == n)	break;
+		}
+	}
+};
+
+//---- instantiate ------------------------------------------------------------
+
+// static
+LogSlot*	LogSlot::CreateBuffered(const string &fn, const FLUSH_POLICY policy, const int interval_ms, const STAMP_FORMAT fmt, const double min_elap_secs, const size_t buff_size)
+{
+	return new BufferedFileLog(fn, policy, interval_ms, fmt, min_elap_secs, buff_size);
+}
+
+// static
+LogSlot*	LogSlot::CreateRotating(const string &fn, const LogRotation &rotation, const FLUSH_POLICY policy, const int interval_ms, const STAMP_FORMAT fmt, const double min_elap_secs, const size_t buff_size)
+{
+	return new BufferedFileLog(fn, policy, interval_ms, fmt, min_elap_secs, buff_size, &rotation);
+}
+
+// static
+LogSlot*	LogSlot::CreateIndexed(const string &fn, const LogIndexing &indexing, const FLUSH_POLICY policy, const int interval_ms, const STAMP_FORMAT fmt, const double min_elap_secs, const size_t buff_size)
+{
+	// (hex level column lets queries match lines exactly)
+	return new BufferedFileLog(fn, policy, interval_ms, fmt | STAMP_FORMAT::LEVEL, min_elap_secs, buff_size, nil, &indexing);
+}
+
+// static
+LogSlot*	LogSlot::CreateJSON(const string &fn, const FLUSH_POLICY policy, const int interval_ms, const size_t buff_size)
+{
+	return new JSONFileLog(fn, policy, interval_ms, buff_size);
+}
+
+// nada mas
@@ -0,0 +1,290 @@
+// lx utils sidecar time/level index writer & reader
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "lx/logindex.h"
+#include "lx/xstring.h"
+
+using namespace std;
+using namespace LX;
+
+//---- little-endian helpers --------------------------------------------------
+
+namespace
+{
+
+void	Put32(string &s, const uint32_t v)
+{
+	for (int i = 0; i < 4; i++)	s.push_back((char) (v >> (i * 8)));
+}
+
+void	Put64(string &s, const uint64_t v)
+{
+	for (int i = 0; i < 8; i++)	s.push_back((char) (v >> (i * 8)));
+}
+
+uint32_t	Get32(const char *p)
+{
+	uint32_t	v = 0;
+	
+	for (int i = 0; i < 4; i++)	v |= (uint32_t) (uint8_t) p[i] << (i * 8);
+	
+	return v;
+}
+
+uint64_t	Get64(const char *p)
+{
+	uint64_t	v = 0;
+	
+	for (int i = 0; i < 8; i++)	v |= (uint64_t) (uint8_t) p[i] << (i * 8);
+	
+	return v;
+}
+
+// unindexed tail is split in chunks of whole lines
+constexpr size_t	TAIL_CHUNK_BYTES = 1024 * 1024;
+
+} // anonymous namespace
+
+//==== Log Index Writer =======================================================
+
+	LogIndexWriter::LogIndexWriter(const string &log_fn, const STAMP_FORMAT fmt, const size_t block_bytes)
+		: m_BlockBytes(std::max<size_t>(block_bytes, 1024)),
+		m_File(::fopen(IndexName(log_fn).c_str(), "wb")),
+		m_Offset(0),
+		m_Block{}
+{
+	assert(m_File);
+	
+	string	hdr(LOGINDEX_MAGIC, sizeof(LOGINDEX_MAGIC));
+	
+	Put32(hdr, LOGINDEX_VERSION);
+	Put32(hdr, (uint32_t) fmt);
+	Put32(hdr, m_BlockBytes);
+	Put32(hdr, 0);				// reserved
+	
+	assert(LOGINDEX_HEADER_SIZE == hdr.size());
+	
+	if (m_File)
+	{	::fwrite(hdr.data(), 1, hdr.size(), m_File);
+		::fflush(m_File);
+	}
+}
+
+	LogIndexWriter::~LogIndexWriter()
+{
+	if (m_File)	::fclose(m_File);
+}
+
+void	LogIndexWriter::AddLine(const size_t n, const int64_t us, const uint32_t level)
+{
+	if (0 == m_Block.m_Lines)
+	{
+		m_Block.m_MinUS = us;
+		m_Block.m_MaxUS = us;
+	}
+	else
+	{	// (async producers' stamps may be slightly out of order)
+		m_Block.m_MinUS = std::min(m_Block.m_MinUS, us);
+		m_Block.m_MaxUS = std::max(m_Block.m_MaxUS, us);
+	}
+	
+	m_Block.m_Bytes += n;
+	m_Block.m_Lines++;
+	m_Block.AddLevel(level);
+	
+	if (m_Block.m_Bytes >= m_BlockBytes)	CloseBlock();
+}
+
+void	LogIndexWriter::CloseBlock(void)
+{
+	if (0 == m_Block.m_Lines)	return;
+	
+	Put64(m_Entries, m_Offset);
+	Put32(m_Entries, m_Block.m_Bytes);
+	Put32(m_Entries, m_Block.m_Lines);
+	Put64(m_Entries, m_Block.m_MinUS);
+	Put64(m_Entries, m_Block.m_MaxUS);
+	
+	for (const uint64_t bits : m_Block.m_LevelBits)		Put64(m_Entries, bits);
+	
+	m_Offset += m_Block.m_Bytes;
+	m_Block = logindex_block{};
+}
+
+void	LogIndexWriter::WriteEntries(const string &entries)
+{
+	if (!m_File || entries.empty())		return;
+	
+	assert(0 == (entries.size() % LOGINDEX_ENTRY_SIZE));
+	
+	::fwrite(entries.data(), 1, entries.size(), m_File);
+	::fflush(m_File);
+}
+
+//==== Log Index Reader =======================================================
+
+	LogIndexReader::LogIndexReader(const string &log_fn)
+		: m_LogName(log_fn),
+		m_IFS(log_fn, ios_base::binary),
+		m_Fmt(STAMP_FORMAT::MILLISEC),
+		m_Indexed(0)
+{
+}
+
+bool	LogIndexReader::Fail(const string &err)
+{
+	m_Error = err;
+	return false;
+}
+
+//---- Load -------------------------------------------------------------------
+
+	// entries must tile the log from offset 0, the first one that doesn't (or lies past its end) ends the index
+
+bool	LogIndexReader::Load(void)
+{
+	m_Blocks.clear();
+	m_Indexed = 0;
+	
+	if (!m_IFS)	return Fail("couldn't open log file");
+	
+	ifstream	idx(LogIndexWriter::IndexName(m_LogName), ios_base::binary);
+	
+	if (!idx)	return Fail("couldn't open index " + LogIndexWriter::IndexName(m_LogName));
+	
+	char	hdr[LOGINDEX_HEADER_SIZE];
+	
+	if (!idx.read(hdr, sizeof(hdr)) || ::memcmp(hdr, LOGINDEX_MAGIC, sizeof(LOGINDEX_MAGIC)))
+		return Fail("not a log index");
+	
+	const uint32_t	version = Get32(hdr + 8);
+	
+	if (LOGINDEX_VERSION != version)	return Fail(xsprintf("unsupported index version %u", version));
+	
+	m_Fmt = (STAMP_FORMAT) Get32(hdr + 12);
+	
+	m_IFS.seekg(0, ios_base::end);
+	const uint64_t	log_size = m_IFS.tellg();
+	
+	uint64_t	pos = 0;
+	char		entry[LOGINDEX_ENTRY_SIZE];
+	
+	while (idx.read(entry, sizeof(entry)))
+	{
+		logindex_block	blk;
+		
+		blk.m_Offset = Get64(entry);
+		blk.m_Bytes = Get32(entry + 8);
+		blk.m_Lines = Get32(entry + 12);
+		blk.m_MinUS = (int64_t) Get64(entry + 16);
+		blk.m_MaxUS = (int64_t) Get64(entry + 24);
+		
+		for (int i = 0; i < 4; i++)	blk.m_LevelBits[i] = Get64(entry + 32 + (i * 8));
+		
+		if ((pos != blk.m_Offset) || ((pos + blk.m_Bytes) > log_size))	break;
+		
+		m_Blocks.push_back(blk);
+		
+		pos += blk.m_Bytes;
+	}
+	
+	m_Indexed = m_Blocks.size();
+	
+	// search helpers
+	m_MaxPrefix.resize(m_Indexed);
+	m_MinSuffix.resize(m_Indexed);
+	
+	for (size_t i = 0; i < m_Indexed; i++)
+		m_MaxPrefix[i] = i ? std::max(m_MaxPrefix[i - 1], m_Blocks[i].m_MaxUS) : m_Blocks[i].m_MaxUS;
+	
+	for (size_t i = m_Indexed; i-- > 0; )
+		m_MinSuffix[i] = ((i + 1) < m_Indexed) ? std::min(m_MinSuffix[i + 1], m_Blocks[i].m_MinUS) : m_Blocks[i].m_MinUS;
+	
+	// unindexed tail (last open block, or a crash) as wildcard blocks, cut after a newline
+	string	chunk;
+	
+	while (pos < log_size)
+	{
+		const size_t	n = std::min<uint64_t>(TAIL_CHUNK_BYTES, log_size - pos);
+		
+		chunk.resize(n);
+		m_IFS.clear();
+		m_IFS.seekg(pos);
+		
+		if (!m_IFS.read(&chunk[0], n))		return Fail("read error");
+		
+		const size_t	nl = chunk.rfind('\n');
+		const size_t	len = ((string::npos == nl) || ((pos + n) == log_size)) ? n : (nl + 1);
+		
+		logindex_block	blk{};
+		
+		blk.m_Offset = pos;
+		blk.m_Bytes = len;
+		blk.m_MinUS = INT64_MIN;
+		blk.m_MaxUS = INT64_MAX;
+		
+		for (auto &bits : blk.m_LevelBits)	bits = ~0ull;
+		
+		m_Blocks.push_back(blk);
+		
+		pos += len;
+	}
+	
+	m_IFS.clear();
+	
+	return true;
+}
+
+//---- Query ------------------------------------------------------------------
+
+	// first candidate is binary-searched on the running max stamp, the scan stops once no later block
+	// starts at/before to_us, so the cost is that of the candidates (plus blocks failing the level test)
+
+void	LogIndexReader::Query(const int64_t from_us, const int64_t to_us, const vector<uint32_t> &levels, vector<logindex_block> &res) const
+{
+	res.clear();
+	
+	uint64_t	bits[4] = {};
+	
+	if (levels.empty())
+		std::fill(std::begin(bits), std::end(bits), ~0ull);
+	else
+	{	for (const uint32_t lvl : levels)	bits[logindex_level_bit(lvl) / 64] |= 1ull << (logindex_level_bit(lvl) % 64);
+	}
+	
+	const size_t	first = std::lower_bound(m_MaxPrefix.begin(), m_MaxPrefix.end(), from_us) - m_MaxPrefix.begin();
+	
+	for (size_t i = first; (i < m_Indexed) && (m_MinSuffix[i] <= to_us); i++)
+	{
+		const logindex_block	&blk = m_Blocks[i];
+		
+		if ((blk.m_MaxUS < from_us) || (blk.m_MinUS > to_us) || !blk.HasAnyLevel(bits))	continue;
+		
+		res.push_back(blk);
+	}
+	
+	// tail is unknown
+	res.insert(res.end(), m_Blocks.begin() + m_Indexed, m_Blocks.end());
+}
+
+//---- Read Block (sequential) ------------------------------------------------
+
+bool	LogIndexReader::ReadBlock(const logindex_block &blk, string &bytes)
+{
+	bytes.resize(blk.m_Bytes);
+	
+	m_IFS.seekg(blk.m_Offset);
+	
+	if (!m_IFS.read(&bytes[0], blk.m_Bytes))	return Fail("read error");
+	
+	return true;
+}
+
+// nada mas
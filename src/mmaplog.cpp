@@ -0,0 +1,286 @@
+// lx utils memory-mapped (crash-surviving) file log
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <new>
+
+#ifndef WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#include "lx/ulog.h"
+
+using namespace std;
+using namespace LX;
+
+#ifndef WIN32
+
+//---- segment header ---------------------------------------------------------
+
+	// each segment file starts with this header, followed by <length> bytes of log text
+	// the tail after a crash is wherever length says, the rest is preallocated zeros
+
+struct mmap_header
+{
+	char			m_Magic[8];		// "LXMMLOG"
+	uint32_t		m_Version;
+	uint32_t		m_HeaderSize;
+	uint64_t		m_SegmentSize;		// incl. header
+	uint64_t		m_SegmentIndex;
+	atomic<uint64_t>	m_Length;		// valid bytes after header
+};
+
+static const char	MMAP_LOG_MAGIC[8] = "LXMMLOG";
+static const size_t	MMAP_HEADER_SIZE = 64;
+
+static_assert(sizeof(mmap_header) <= MMAP_HEADER_SIZE, "mmap log header overflow");
+
+//---- Mapped File Log --------------------------------------------------------
+
+	// appending a line is a memcpy into the shared mapping + atomic tail update,
+	// so lines survive a process crash in the page cache without any flush
+	// segments are named <fn>.0000, <fn>.0001, ... and roll over when full
+	// on startup, the previous runs' segments are renamed aside to <fn>.prev1.NNNN (latest)
+	// up to <fn>.prev<keep_runs>.NNNN, older ones are deleted, so a restart after a crash
+	// never destroys what the crashed run left
+
+class MappedFileLog : public LogSlot
+{
+public:
+	// ctor
+	MappedFileLog(const string &fname, const size_t segment_size, const STAMP_FORMAT fmt, const double min_elap_secs, const size_t keep_runs)
+		: LogSlot{},
+		m_BaseName(fname),
+		m_SegmentSize(std::max<size_t>(segment_size, MMAP_HEADER_SIZE + 4096)),
+		m_LineComposer(fmt, min_elap_secs),
+		m_SegmentIndex(0),
+		m_FD(-1),
+		m_Map(nil),
+		m_Header(nil)
+	{
+		KeepPreviousRuns(keep_runs);
+		
+		const bool	ok = OpenSegment(0);
+		assert(ok);
+		(void)ok;
+	}
+	// dtor
+	virtual ~MappedFileLog()
+	{
+		DisconnectSelf();
+		
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		CloseSegment();
+	}
+	
+	// IMP
+	void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) override
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		mmap_header	*header = m_Header.load(memory_order_relaxed);
+		if (!header)		return;		// couldn't map
+		
+		m_Line.clear();
+		
+		m_LineComposer.Compose(m_Line, stamp, level, msg, thread_id);
+		
+		const size_t	capacity = m_SegmentSize - MMAP_HEADER_SIZE;
+		
+		// (truncate monster lines)
+		if (m_Line.size() > capacity)
+		{	m_Line.resize(capacity - 1);
+			m_Line.push_back('\n');
+		}
+		
+		uint64_t	len = header->m_Length.load(memory_order_relaxed);
+		
+		if ((len + m_Line.size()) > capacity)
+		{	// roll over
+			CloseSegment();
+			
+			if (!OpenSegment(m_SegmentIndex + 1))	return;
+			
+			header = m_Header.load(memory_order_relaxed);
+			len = 0;
+		}
+		
+		::memcpy(m_Map.load(memory_order_relaxed) + MMAP_HEADER_SIZE + len, m_Line.data(), m_Line.size());
+		
+		// publish tail
+		header->m_Length.store(len + m_Line.size(), memory_order_release);
+	}
+
+	// IMP: lines are already in the page cache, crash-time lines only go in if the current segment has room
+	bool	CrashFlush(void) override
+	{
+		return m_Header.load(memory_order_acquire) != nil;
+	}
+	
+	// (no lock, segment pointers are loaded once; a mismatched pair means mid-rollover)
+	void	CrashLog(const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id) override
+	{
+		mmap_header	*header = m_Header.load(memory_order_acquire);
+		char		*map = m_Map.load(memory_order_acquire);
+		if (!header || (map != reinterpret_cast<char*>(header)))	return;	// (rolling over)
+		
+		char		line[LogLine::CRASH_LINE_MAX];
+		const size_t	n = m_LineComposer.CrashCompose(line, sizeof(line), stamp, level, msg, len, thread_id);
+		const uint64_t	tail = header->m_Length.load(memory_order_acquire);
+		
+		if ((tail + n) > (m_SegmentSize - MMAP_HEADER_SIZE))	return;
+		
+		::memcpy(map + MMAP_HEADER_SIZE + tail, line, n);
+		
+		header->m_Length.store(tail + n, memory_order_release);
+	}
+
+private:
+
+	static
+	string	SegmentName(const string &base, const size_t index)
+	{
+		char	suffix[32];
+		
+		snprintf(suffix, sizeof(suffix), ".%04zu", index);
+		
+		return base + suffix;
+	}
+	
+	string	SegmentName(const size_t index) const
+	{
+		return SegmentName(m_BaseName, index);
+	}
+	
+	// base name of the run <run> starts ago (0 = this one)
+	string	RunName(const size_t run) const
+	{
+		return run ? (m_BaseName + ".prev" + to_string(run)) : m_BaseName;
+	}
+	
+	static
+	void	RemoveSegments(const string &base)
+	{
+		for (size_t i = 0; 0 == ::unlink(SegmentName(base, i).c_str()); i++)	{}
+	}
+	
+	// (destination was emptied first, so runs never mix)
+	static
+	void	RenameSegments(const string &from, const string &to)
+	{
+		RemoveSegments(to);
+		
+		for (size_t i = 0; 0 == ::rename(SegmentName(from, i).c_str(), SegmentName(to, i).c_str()); i++)	{}
+	}
+	
+	// shifts previous runs one back, the oldest beyond keep_runs is dropped
+	// (keep_runs = 0 deletes the previous run, which would otherwise look like ours)
+	void	KeepPreviousRuns(const size_t keep_runs)
+	{
+		for (size_t run = keep_runs; run > 0; run--)	RenameSegments(RunName(run - 1), RunName(run));
+		
+		RemoveSegments(RunName(0));
+	}
+	
+	bool	OpenSegment(const size_t index)
+	{
+		assert(!m_Map.load(memory_order_relaxed));
+		
+		const string	fn = SegmentName(index);
+		
+		m_FD = ::open(fn.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (m_FD < 0)		return false;
+		
+		// reserve blocks up front so page faults can't SIGBUS on a full disk
+		#ifdef __linux__
+			const bool	alloc_ok = (0 == ::posix_fallocate(m_FD, 0, m_SegmentSize));
+		#else
+			const bool	alloc_ok = (0 == ::ftruncate(m_FD, m_SegmentSize));
+		#endif
+		
+		void	*p = alloc_ok ? ::mmap(nil, m_SegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_FD, 0) : MAP_FAILED;
+		
+		if (MAP_FAILED == p)
+		{
+			::close(m_FD);
+			m_FD = -1;
+			return false;
+		}
+		
+		char		*map = static_cast<char*>(p);
+		mmap_header	*header = new (map) mmap_header;
+		
+		::memcpy(header->m_Magic, MMAP_LOG_MAGIC, sizeof(MMAP_LOG_MAGIC));
+		header->m_Version = 1;
+		header->m_HeaderSize = MMAP_HEADER_SIZE;
+		header->m_SegmentSize = m_SegmentSize;
+		header->m_SegmentIndex = index;
+		header->m_Length.store(0, memory_order_release);
+		
+		m_SegmentIndex = index;
+		
+		// (published once initialized, for CrashLog)
+		m_Map.store(map, memory_order_release);
+		m_Header.store(header, memory_order_release);
+		
+		return true;
+	}
+	
+	// on clean close, trim preallocated tail
+	// (pointers are cleared before unmapping, so a CrashLog from then on skips this segment)
+	void	CloseSegment(void)
+	{
+		char	*map = m_Map.load(memory_order_relaxed);
+		if (!map)	return;
+		
+		const uint64_t	len = m_Header.load(memory_order_relaxed)->m_Length.load(memory_order_acquire);
+		
+		m_Header.store(nil, memory_order_seq_cst);
+		m_Map.store(nil, memory_order_seq_cst);
+		
+		::munmap(map, m_SegmentSize);
+		
+		const int	res = ::ftruncate(m_FD, MMAP_HEADER_SIZE + len);
+		(void)res;
+		
+		::close(m_FD);
+		m_FD = -1;
+	}
+	
+	const string		m_BaseName;
+	const size_t		m_SegmentSize;
+	LogLine			m_LineComposer;
+	
+	mutable mutex		m_Mutex;
+	size_t			m_SegmentIndex;
+	int			m_FD;
+	atomic<char*>		m_Map;
+	atomic<mmap_header*>	m_Header;
+	string			m_Line;
+};
+
+#endif // WIN32
+
+//---- instantiate ------------------------------------------------------------
+
+// static
+LogSlot*	LogSlot::CreateMapped(const string &fn, const size_t segment_size, const STAMP_FORMAT fmt, const double min_elap_secs, const size_t keep_runs)
+{
+	#ifndef WIN32
+		return new MappedFileLog(fn, segment_size, fmt, min_elap_secs, keep_runs);
+	#else
+		(void)fn; (void)segment_size; (void)fmt; (void)min_elap_secs; (void)keep_runs;
+		return nil;		// not implemented
+	#endif
+}
+
+// nada mas
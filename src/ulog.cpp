@@ -5,8 +5,20 @@
 #include <fstream>
 #include <mutex>
 #include <thread>
+#include <condition_variable>
+#include <set>
+#include <deque>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#ifndef WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 
 #include "lx/ulog.h"
+#include "lx/xqueue.h"
 
 using namespace std;
 using namespace LX;
@@ -14,19 +26,316 @@ using namespace LX;
 std::once_flag s_root_log_once_f;
 
 static
-rootLog*	s_rootLog = nil;
+atomic<rootLog*>	s_rootLog{nil};		// (retired like a slot list, see Emit Epochs)
+
+//==== Level IDs ==============================================================
+
+	// open-addressed (level hash -> id) cells at <= 50% load, written once under mutex, read lock-free
+	// all constant-initialized, so other translation units' static initializers may register tags
+
+namespace
+{
+
+constexpr size_t	LEVEL_ID_CELLS = LOG_LEVEL_ID_MAX * 2;
+
+atomic<uint64_t>	s_LevelCells[LEVEL_ID_CELLS];		// (level << 16) | id, 0 = empty
+atomic<const char*>	s_LevelNames[LOG_LEVEL_ID_MAX];
+mutex			s_LevelIDMutex;				// (writers only)
+size_t			s_NextLevelID = 1;
+
+size_t	LevelCell(const LogLevel lvl)
+{
+	return ((uint32_t)lvl * 2654435761ul) & (LEVEL_ID_CELLS - 1);
+}
+
+} // anonymous namespace
+
+LogLevelID	LX::log_level_find(const LogLevel lvl)
+{
+	for (size_t i = LevelCell(lvl); true; i = (i + 1) & (LEVEL_ID_CELLS - 1))
+	{
+		const uint64_t	cell = s_LevelCells[i].load(memory_order_acquire);
+		
+		if (!cell)			return 0;
+		if ((cell >> 16) == lvl)	return (LogLevelID) cell;
+	}
+}
+
+LogLevelID	LX::log_level_id(const LogLevel lvl)
+{
+	if (LOG_NIL == lvl)	return 0;
+	
+	const LogLevelID	found = log_level_find(lvl);
+	if (found)		return found;
+	
+	unique_lock<mutex>	locker(s_LevelIDMutex);
+	
+	size_t	i = LevelCell(lvl);
+	
+	for (; s_LevelCells[i].load(memory_order_relaxed); i = (i + 1) & (LEVEL_ID_CELLS - 1))
+	{
+		const uint64_t	cell = s_LevelCells[i].load(memory_order_relaxed);
+		
+		if ((cell >> 16) == lvl)	return (LogLevelID) cell;		// (raced)
+	}
+	
+	// full: tag can't be enabled, subscribed to or limited
+	assert(s_NextLevelID < LOG_LEVEL_ID_MAX);
+	if (s_NextLevelID >= LOG_LEVEL_ID_MAX)	return 0;
+	
+	const LogLevelID	id = s_NextLevelID++;
+	
+	s_LevelCells[i].store(((uint64_t)lvl << 16) | id, memory_order_release);
+	
+	return id;
+}
+
+	// names are copied, first registration wins
+
+LogLevelID	LX::log_level_register(const char *name)
+{
+	const LogLevel		lvl = log_hash(name);
+	const LogLevelID	id = log_level_id(lvl);
+	if (!id)		return 0;
+	
+	unique_lock<mutex>	locker(s_LevelIDMutex);
+	
+	const char	*prev = s_LevelNames[id].load(memory_order_relaxed);
+	
+	if (prev)
+	{	// two different tags collide, they'd be indistinguishable
+		assert(!::strcmp(prev, name));
+		return ::strcmp(prev, name) ? 0 : id;
+	}
+	
+	// (lives as long as the process, constructed on first use so safe during static init)
+	static deque<string>	&s_NameStore = *new deque<string>;
+	
+	s_NameStore.emplace_back(name);
+	s_LevelNames[id].store(s_NameStore.back().c_str(), memory_order_release);
+	
+	return id;
+}
+
+const char*	LX::log_level_name(const LogLevel lvl)
+{
+	const LogLevelID	id = log_level_find(lvl);
+	
+	return id ? s_LevelNames[id].load(memory_order_acquire) : nil;
+}
+
+	// built-in tags (see BASE_LOG_MACRO)
+
+static const bool	s_BaseLevelsRegistered = []()
+{
+	for (const char *name : {"FATAL", "LX_ERROR", "EXCEPTION", "WARNING", "LX_MSG", "DTOR", "UNIT", "DELAYER", "APP_INIT", "SIG", "CROSS_THREAD", "JUCE_LOG", "LOG_OP", "LOG_DEF"})
+		log_level_register(name);
+	
+	return true;
+}();
 
 static const
-unordered_set<LogLevel>	s_LogOps
+LogLevelBits	s_LogOps = []()
+{
+	LogLevelBits	bits;
+	
+	bits.Set(log_level_id(LOG_DEF));
+	
+	return bits;
+}();
+
+//==== Emit Epochs ============================================================
+
+	// epoch-based reclamation of slot list snapshots, slots & the root singleton:
+	// each emitting thread advertises the global epoch it entered at (0 when outside),
+	// a writer swaps the shared pointer, bumps the epoch, then waits until every OTHER
+	// thread is either outside or entered after the bump. Reader records are never freed,
+	// a thread gives its record back on exit for the next thread to reuse
+
+namespace
+{
+
+struct EpochReader
+{
+	atomic<uint64_t>	m_Epoch{0};
+	atomic<bool>		m_UsedFlag{true};
+	EpochReader		*m_Next = nil;		// (immutable once linked)
+	size_t			m_Depth = 0;		// nested emissions (owner thread only)
+};
+
+class EpochDomain
+{
+public:
+	uint64_t	Current(void) const
+	{
+		return m_Epoch.load(memory_order_relaxed);
+	}
+	
+	// returns the new epoch, retired objects are tagged with it
+	uint64_t	Advance(void)
+	{
+		return m_Epoch.fetch_add(1, memory_order_seq_cst) + 1;
+	}
+	
+	EpochReader*	Acquire(void)
+	{
+		for (EpochReader *r = m_Head.load(memory_order_acquire); r; r = r->m_Next)
+		{
+			bool	used_f = false;
+			
+			if (!r->m_UsedFlag.load(memory_order_relaxed) && r->m_UsedFlag.compare_exchange_strong(used_f, true))
+				return r;
+		}
+		
+		EpochReader	*r = new EpochReader();
+		
+		r->m_Next = m_Head.load(memory_order_relaxed);
+		
+		while (!m_Head.compare_exchange_weak(r->m_Next, r, memory_order_release, memory_order_relaxed))	{}
+		
+		return r;
+	}
+	
+	void	Release(EpochReader *r)
+	{
+		assert(r && !r->m_Depth);
+		
+		r->m_UsedFlag.store(false, memory_order_release);
+	}
+	
+	// oldest epoch still inside an emission (0 if none)
+	uint64_t	OldestActive(void) const
+	{
+		uint64_t	oldest = 0;
+		
+		for (const EpochReader *r = m_Head.load(memory_order_acquire); r; r = r->m_Next)
+		{
+			const uint64_t	e = r->m_Epoch.load(memory_order_seq_cst);
+			
+			if (e && (!oldest || (e < oldest)))	oldest = e;
+		}
+		
+		return oldest;
+	}
+	
+	// waits for other threads that entered before epoch
+	void	Synchronize(const uint64_t epoch, const EpochReader *self) const
+	{
+		for (const EpochReader *r = m_Head.load(memory_order_acquire); r; r = r->m_Next)
+		{
+			if (r == self)		continue;
+			
+			while (true)
+			{
+				const uint64_t	e = r->m_Epoch.load(memory_order_seq_cst);
+				if (!e || (e >= epoch))		break;
+				
+				this_thread::yield();
+			}
+		}
+	}
+	
+private:
+	
+	atomic<uint64_t>	m_Epoch{1};
+	atomic<EpochReader*>	m_Head{nil};
+};
+
+EpochDomain	s_Epochs;		// (constant-initialized, trivially destructible)
+
+thread_local
+EpochReader	*s_EpochReader = nil;
+
+// gives the record back on thread exit
+struct EpochRelease
 {
+	~EpochRelease()
+	{
+		s_Epochs.Release(s_EpochReader);
+		s_EpochReader = nil;		// (a thread_local dtor logging after this grabs a record for good)
+	}
+};
+
+EpochReader&	ThisEpochReader(void)
+{
+	if (!s_EpochReader)
+	{
+		s_EpochReader = s_Epochs.Acquire();
+		
+		static thread_local EpochRelease	s_Release;		// (registered once per thread)
+		(void)s_Release;
+	}
+	
+	return *s_EpochReader;
+}
 
-	LOG_DEF,
+// emission scope, nests
+class EmitGuard
+{
+public:
+	EmitGuard()
+		: m_Reader(ThisEpochReader())
+	{
+		// (seq_cst orders the announce before loading any shared pointer)
+		if (0 == m_Reader.m_Depth++)
+			m_Reader.m_Epoch.store(s_Epochs.Current(), memory_order_seq_cst);
+	}
+	
+	~EmitGuard()
+	{
+		if (0 == --m_Reader.m_Depth)
+			m_Reader.m_Epoch.store(0, memory_order_release);
+	}
+	
+	static
+	bool	IsEmitting(void)
+	{
+		return s_EpochReader && s_EpochReader->m_Depth;
+	}
+	
+private:
+	
+	EpochReader	&m_Reader;
 };
 
+	// a writer that swapped out a snapshot waits for the grace period WITHOUT its mutex, since
+	// a slot busy on another thread may itself take it; from inside an emission it can't wait
+	// for other emitters (they may wait for us), so only what's already safe is reclaimed
+	// returns the epoch up to which retired snapshots can go (0 = all)
+
+uint64_t	GracePeriod(const uint64_t retire_epoch, unique_lock<mutex> &locker)
+{
+	if (EmitGuard::IsEmitting())	return s_Epochs.OldestActive();
+	
+	locker.unlock();
+	
+	s_Epochs.Synchronize(retire_epoch, nil);
+	
+	locker.lock();
+	
+	return retire_epoch;
+}
+
+// a snapshot retired at epoch E can go once nobody is inside from before E
+template<typename _T>
+void	Reclaim(vector<std::pair<uint64_t, unique_ptr<_T>>> &retired, const uint64_t safe_epoch)
+{
+	auto	it = remove_if(retired.begin(), retired.end(), [&](const std::pair<uint64_t, unique_ptr<_T>> &r)
+	{
+		return !safe_epoch || (r.first <= safe_epoch);
+	});
+	
+	retired.erase(it, retired.end());
+}
+
+} // anonymous namespace
+
 //==== Log Slot (may have multiple) ===========================================
 
 	LogSlot::LogSlot()
-		: m_OrgSignal{nil}
+		: m_OrgSignal{nil},
+		m_AllLevelsFlag(true),
+		m_Levels{}
 {
 }
 
@@ -37,14 +346,39 @@ unordered_set<LogLevel>	s_LogOps
 
 void	LogSlot::DisconnectSelf(void)
 {
-	if (!m_OrgSignal)	return;
+	LogSignal	*sig = m_OrgSignal.load();
+	if (!sig)	return;
 	
-	m_OrgSignal->Disconnect(this);
+	sig->Disconnect(this);
 	
 	// (was set to nil by signal)
 	assert(nil == m_OrgSignal);
 }
 
+//---- Subscribe Levels -------------------------------------------------------
+
+void	LogSlot::SubscribeLevels(const unordered_set<LogLevel> &levels)
+{
+	LogSignal	*sig = m_OrgSignal.load();
+	
+	if (sig)	sig->Subscribe(this, false/*all*/, levels);
+	else
+	{	m_AllLevelsFlag = false;
+		m_Levels = levels;
+	}
+}
+
+void	LogSlot::SubscribeAllLevels(void)
+{
+	LogSignal	*sig = m_OrgSignal.load();
+	
+	if (sig)	sig->Subscribe(this, true/*all*/, {});
+	else
+	{	m_AllLevelsFlag = true;
+		m_Levels.clear();
+	}
+}
+
 void	LogSlot::SetSignal(LogSignal *sig)
 {
 	m_OrgSignal = sig;
@@ -58,12 +392,12 @@ void	LogSlot::RemoveSignal(void)
 // static
 bool	LogSlot::IsLogOp(const LogLevel level)
 {
-	return s_LogOps.count(level);
+	return s_LogOps.Test(log_level_find(level));
 }
 
 void	LogSlot::LogAtLevel_LL(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) 
 {
-	if (!m_OrgSignal)	return;		// was already disconnected
+	if (!m_OrgSignal.load(memory_order_relaxed))	return;		// was already disconnected
 	
 	// if (LogSlot::IsLogOp(level))
 	{	// LogAtLevel(stamp, LOG_OP, "", thread_id);		// could send binary chunk?
@@ -71,176 +405,1594 @@ void	LogSlot::LogAtLevel_LL(const timestamp_t stamp, const LogLevel level, const
 	}
 }
 
-//==== Log Signal (currently singleton) =======================================
+void	LogSlot::LogRecordAtLevel_LL(const LogRecord &rec)
+{
+	if (!m_OrgSignal.load(memory_order_relaxed))	return;		// was already disconnected
+	
+	LogRecordAtLevel(rec);
+}
 
-	LogSignal::LogSignal()
-		: m_SlotList{}
+// default: render deferred record (if wasn't already)
+void	LogSlot::LogRecordAtLevel(const LogRecord &rec)
 {
-	// assign 1st thread
-	GetThreadIndex(this_thread::get_id());
+	LogAtLevel(rec.m_Stamp, rec.m_Level, rec.Msg(), rec.m_ThreadIndex);
 }
+
+//==== Log Record =============================================================
+
+	// renders deferred record off the producer's thread (or at least only if needed)
+
+const string&	LogRecord::Msg(void) const
+{
+	if (!m_Msg.empty())	return m_Msg;
 	
-	LogSignal::~LogSignal()
+	if (m_FieldsFlag)
+	{
+		xout	out(m_Msg);
+		
+		RenderFields(out);
+		return m_Msg;
+	}
+	
+	if (!m_Fmt)		return m_Msg;
+	
+	try
+	{
+		xout	out(m_Msg);
+		
+		m_Args.Render(m_Fmt, out);
+	}
+	catch (std::runtime_error &e)
+	{
+		const char	*what_s = e.what();	// (don't allocate)
+		xtrap(what_s);
+		
+		// can't re-throw to producer, log the failure instead
+		m_Msg = string(what_s) + " in deferred format \"" + m_Fmt + "\"";
+	}
+	
+	return m_Msg;
+}
+
+//---- Render Fields (structured record) --------------------------------------
+
+void	LogRecord::RenderFields(xout &out) const
 {
-	DisconnectAll();
+	size_t		pos = 0;
+	xarg_view	msg, key, val;
+	
+	if (!m_Args.Next(pos, msg))	return;
+	
+	out.append(msg.m_Data, msg.m_Size);
+	
+	while (m_Args.Next(pos, key) && m_Args.Next(pos, val))
+		AppendField(out, key, val);
 }
 
-void	LogSignal::Connect(LogSlot *slot)
+// static
+void	LogRecord::AppendField(xout &out, const xarg_view &key, const xarg_view &val)
 {
-	assert(slot);
+	const bool	quote_f = (XARG_T::STR == val.m_Tag) || (XARG_T::CHAR == val.m_Tag);
 	
-	// check no duplicates
-	assert(find(m_SlotList.begin(), m_SlotList.end(), slot) == m_SlotList.end());
+	out.push_back(' ');
+	out.append(key.m_Data, key.m_Size);
+	out.push_back('=');
 	
-	m_SlotList.push_back(slot);
+	if (quote_f)	out.push_back('"');
 	
-	slot->SetSignal(this);
+	val.Render(out);
+	
+	if (quote_f)	out.push_back('"');
 }
 
-void	LogSignal::Disconnect(LogSlot *slot)
+//==== Log Site ===============================================================
+
+atomic<uint32_t>	LogSite::s_Generation{1};
+
+// static
+void	LogSite::BumpGeneration(void)
 {
-	assert(slot);
+	s_Generation.fetch_add(1, memory_order_release);
+}
+
+	// generation is read BEFORE evaluating, so a concurrent bump forces another refresh
+
+bool	LogSite::Refresh(void) const
+{
+	const uint32_t	gen = s_Generation.load(memory_order_acquire);
+	
+	const bool	f = rootLog::HasLogLevel_LL(m_Level);
+	
+	m_State.store((gen << 1) | (f ? 1 : 0), memory_order_relaxed);
+	
+	return f;
+}
+
+//==== Log Limiter ============================================================
+
+namespace
+{
+
+int64_t	SteadyMicroSecs(void)
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// reporter wakes up this often, summaries are due per limiter (see LogLimit::m_SummarySecs)
+constexpr int	LIMITER_REPORT_TICK_MS = 1000;
+
+// live limiters, for periodic & final reports (leaked so statics can unregister at any time)
+// nothing is emitted under the mutex, so it's always taken last
+struct LimiterRegistry
+{
+	mutex			m_Mutex;
+	set<LogLimiter*>	m_Limiters;
+	
+	// periodic reporter, started by the first suppressed record
+	atomic<bool>		m_ReporterFlag{false};
+	thread			m_Reporter;
+	condition_variable	m_ReporterCond;
+	bool			m_ExitFlag = false;
+	
+	static
+	LimiterRegistry&	Get(void)
+	{
+		static LimiterRegistry	*s_Registry = new LimiterRegistry();
+		
+		return *s_Registry;
+	}
+	
+	void	StartReporter(void)
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		if (m_Reporter.joinable())	return;
+		
+		m_ExitFlag = false;
+		m_Reporter = thread(&LimiterRegistry::ReportLoop, this);
+		m_ReporterFlag.store(true, memory_order_release);
+	}
+	
+	void	StopReporter(void)
+	{
+		thread	reporter;
+		
+		{	unique_lock<mutex>	locker(m_Mutex);
+		
+			m_ExitFlag = true;
+			reporter.swap(m_Reporter);
+			m_ReporterFlag.store(false, memory_order_release);
+		}
+		
+		m_ReporterCond.notify_one();
+		
+		if (reporter.joinable())	reporter.join();
+	}
+	
+private:
+	
+	void	ReportLoop(void)
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		while (!m_ExitFlag)
+		{
+			m_ReporterCond.wait_for(locker, chrono::milliseconds(LIMITER_REPORT_TICK_MS), [&]{return m_ExitFlag;});
+			if (m_ExitFlag)		break;
+			
+			locker.unlock();
+			
+			LogLimiter::ReportDue(false/*force*/);
+			
+			locker.lock();
+		}
+	}
+};
+
+} // anonymous namespace
+
+	LogLimiter::LogLimiter(const LogLimit &limit, const char *site)
+		: m_Site(site),
+		m_IntervalUS((limit.m_PerSec > 0) ? max<int64_t>(1, (int64_t)(1000000.0 / limit.m_PerSec)) : 0),
+		m_ToleranceUS((int64_t)(max(limit.m_Burst - 1, 0.0) * m_IntervalUS)),
+		m_SampleN(max<uint32_t>(1, limit.m_SampleN)),
+		m_SummaryUS((int64_t)(limit.m_SummarySecs * 1000000)),
+		m_ArrivalUS{0},
+		m_SampleCount{0},
+		m_Suppressed{0},
+		m_LastReportUS{SteadyMicroSecs()},
+		m_FirstSuppressedUS{0},
+		m_LastLevel{LOG_NIL}
+{
+	LimiterRegistry	&reg = LimiterRegistry::Get();
+	
+	lock_guard<mutex>	locker(reg.m_Mutex);
+	
+	reg.m_Limiters.insert(this);
+}
+
+	LogLimiter::~LogLimiter()
+{
+	LimiterRegistry	&reg = LimiterRegistry::Get();
+	
+	lock_guard<mutex>	locker(reg.m_Mutex);
+	
+	reg.m_Limiters.erase(this);
+}
+
+//---- Admit ------------------------------------------------------------------
+
+bool	LogLimiter::Admit(const LogLevel lvl)
+{
+	const int64_t	now_us = SteadyMicroSecs();
+	
+	bool	ok = true;
+	
+	if (m_IntervalUS > 0)
+	{	// token bucket: admit if the theoretical arrival time isn't further ahead than the burst slack
+		int64_t	arrival_us = m_ArrivalUS.load(memory_order_relaxed);
+		
+		while (true)
+		{
+			const int64_t	base_us = max(arrival_us, now_us);
+			
+			if ((base_us - now_us) > m_ToleranceUS)
+			{	ok = false;
+				break;
+			}
+			
+			if (m_ArrivalUS.compare_exchange_weak(arrival_us, base_us + m_IntervalUS, memory_order_relaxed))
+				break;
+		}
+	}
+	
+	if (ok && (m_SampleN > 1))
+		ok = (0 == (m_SampleCount.fetch_add(1, memory_order_relaxed) % m_SampleN));
+	
+	// (shared lines are only written when dropping)
+	if (!ok)
+	{
+		m_LastLevel.store(lvl, memory_order_relaxed);
+		
+		if (0 == m_Suppressed.fetch_add(1, memory_order_relaxed))
+		{
+			int64_t	none_us = 0;
+			
+			m_FirstSuppressedUS.compare_exchange_strong(none_us, now_us, memory_order_relaxed);
+		}
+		
+		LimiterRegistry	&reg = LimiterRegistry::Get();
+		
+		if (!reg.m_ReporterFlag.load(memory_order_acquire))	reg.StartReporter();
+	}
+	
+	if (m_Suppressed.load(memory_order_relaxed))	Report(now_us, false/*force*/);
+	
+	return ok;
+}
+
+//---- Report suppressed count ------------------------------------------------
+
+	// one thread wins the CAS on the report time, the summary itself isn't limited
+	// the window runs from the first record dropped since the previous summary
+
+bool	LogLimiter::TakeSummary(const int64_t now_us, const bool force_f, LogLevel &lvl, string &msg)
+{
+	int64_t	last_us = m_LastReportUS.load(memory_order_relaxed);
+	
+	if (!force_f && ((now_us - last_us) < m_SummaryUS))		return false;
+	if (!m_LastReportUS.compare_exchange_strong(last_us, now_us))	return false;		// another thread reports
+	
+	const uint64_t	n = m_Suppressed.exchange(0, memory_order_relaxed);
+	if (!n)		return false;
+	
+	const int64_t	first_us = m_FirstSuppressedUS.exchange(0, memory_order_relaxed);
+	const double	secs = (now_us - (first_us ? first_us : last_us)) * 0.000001;
+	
+	lvl = m_LastLevel.load(memory_order_relaxed);
+	
+	if (m_Site)	msg = xsprintf("%s: suppressed %zu message(s) in last %.1f secs", m_Site, (size_t)n, secs);
+	else		msg = xsprintf("suppressed %zu message(s) in last %.1f secs", (size_t)n, secs);
+	
+	return true;
+}
+
+void	LogLimiter::Report(const int64_t now_us, const bool force_f)
+{
+	LogLevel	lvl;
+	string		msg;
+	
+	if (TakeSummary(now_us, force_f, lvl, msg))	rootLog::DoULog_LL(lvl, std::move(msg));
+}
+
+	// summaries are taken under the registry mutex but emitted after it's released,
+	// so a slot may hit or create limiters
+
+// static
+void	LogLimiter::ReportDue(const bool force_f)
+{
+	vector<std::pair<LogLevel, string>>	summaries;
+	
+	{	LimiterRegistry	&reg = LimiterRegistry::Get();
+		
+		lock_guard<mutex>	locker(reg.m_Mutex);
+		
+		const int64_t	now_us = SteadyMicroSecs();
+		LogLevel	lvl;
+		string		msg;
+		
+		for (LogLimiter *limiter : reg.m_Limiters)
+		{
+			if (limiter->m_Suppressed.load() && limiter->TakeSummary(now_us, force_f, lvl, msg))
+				summaries.emplace_back(lvl, std::move(msg));
+		}
+	}
+	
+	for (auto &it : summaries)	rootLog::DoULog_LL(it.first, std::move(it.second));
+}
+
+// static
+void	LogLimiter::ReportAll(void)
+{
+	ReportDue(true/*force*/);
+}
+
+// static
+void	LogLimiter::StopReporter(void)
+{
+	LimiterRegistry::Get().StopReporter();
+}
+
+//==== Slot Masks =============================================================
+
+	// level id -> slot bitmask array (up to the highest subscribed id) of a slot list,
+	// slots subscribed to all levels are in every mask
+
+namespace LX
+{
+
+class SlotMasks
+{
+public:
+	// ctor
+	SlotMasks(const vector<LogSlot*> &slots)
+		: m_AllMask(0),
+		m_Masks{}
+	{
+		assert(slots.size() <= LogSignal::MAX_SLOTS);
+		
+		for (size_t i = 0; i < slots.size(); i++)
+		{
+			const uint64_t	bit = 1ull << i;
+			
+			if (slots[i]->IsSubscribedToAll())
+			{	m_AllMask |= bit;
+				continue;
+			}
+			
+			for (const LogLevel lvl : slots[i]->GetSubscribedLevels())
+			{
+				const LogLevelID	id = log_level_id(lvl);
+				if (!id)	continue;
+		
+				if (id >= m_Masks.size())	m_Masks.resize(id + 1, 0);
+		
+				m_Masks[id] |= bit;
+			}
+		}
+	}
+	
+	// bit i set = slot i subscribes to level
+	uint64_t	ForID(const LogLevelID id) const
+	{
+		return (id && (id < m_Masks.size())) ? (m_AllMask | m_Masks[id]) : m_AllMask;
+	}
+	
+	bool	operator==(const SlotMasks &o) const
+	{
+		return (m_AllMask == o.m_AllMask) && (m_Masks == o.m_Masks);
+	}
+	
+private:
+	
+	uint64_t		m_AllMask;
+	vector<uint64_t>	m_Masks;		// by level id
+};
+
+//==== Slot Table =============================================================
+
+	// immutable snapshot of a signal's slots with their (shared, longer-lived) masks
+
+class SlotTable
+{
+public:
+	// ctor
+	SlotTable(const vector<LogSlot*> &slots, const SlotMasks *masks)
+		: m_Slots(slots),
+		m_Masks(masks)
+	{
+	}
+	
+	const vector<LogSlot*>&	Slots(void) const
+	{
+		return m_Slots;
+	}
+	
+	bool	Has(const LogSlot *slot) const
+	{
+		return find(m_Slots.begin(), m_Slots.end(), slot) != m_Slots.end();
+	}
+	
+	// lock-free lookup of level's id, see log_level_find
+	uint64_t	SlotMask(const LogLevel lvl) const
+	{
+		return m_Masks->ForID(log_level_find(lvl));
+	}
+	
+private:
+	
+	const vector<LogSlot*>	m_Slots;
+	const SlotMasks		*m_Masks;
+};
+
+} // namespace LX
+
+//==== Log Signal (currently singleton) =======================================
+
+// (odr-used when bound to xsprintf's const ref)
+constexpr size_t	LogSignal::MAX_SLOTS;
+
+	LogSignal::LogSignal()
+		: m_SlotTable{nil},
+		m_SlotMasks{nil}
+{
+	m_MaskSets.emplace_back(new SlotMasks({}));
+	m_SlotMasks.store(m_MaskSets.back().get());
+	m_SlotTable.store(new SlotTable({}, m_SlotMasks.load()));
+	
+	// assign 1st thread
+	GetThreadIndex();
+}
+	
+	LogSignal::~LogSignal()
+{
+	DisconnectAll();
+	
+	delete m_SlotTable.load();
+}
+
+void	LogSignal::Connect(LogSlot *slot)
+{
+	assert(slot);
+	
+	unique_lock<mutex>	locker(m_SlotMutex);
+	
+	vector<LogSlot*>	slots = m_SlotTable.load()->Slots();
+	
+	// check no duplicates
+	assert(find(slots.begin(), slots.end(), slot) == slots.end());
+	
+	if (slots.size() >= MAX_SLOTS)
+		throw std::runtime_error(xsprintf("LogSignal::Connect() can't exceed %zu slots", MAX_SLOTS));
+	
+	slots.push_back(slot);
+	
+	slot->SetSignal(this);
+	
+	Publish(slots, locker);
+}
+
+void	LogSignal::Disconnect(LogSlot *slot)
+{
+	assert(slot);
+	
+	unique_lock<mutex>	locker(m_SlotMutex);
+	
+	vector<LogSlot*>	slots = m_SlotTable.load()->Slots();
+	
+	auto	it = find(slots.begin(), slots.end(), slot);
+	assert(slots.end() != it);
+	
+	// remove from list first so can log during disconnection (?)
+	slots.erase(it);
+	
+	slot->RemoveSignal();
+	
+	// returns once no other thread can still be inside slot (unless emitting ourselves)
+	Publish(slots, locker);
+}
+
+//---- Subscribe (connected slot) ---------------------------------------------
+
+void	LogSignal::Subscribe(LogSlot *slot, const bool all_f, const unordered_set<LogLevel> &levels)
+{
+	assert(slot);
+	
+	unique_lock<mutex>	locker(m_SlotMutex);
+	
+	slot->m_AllLevelsFlag = all_f;
+	slot->m_Levels = levels;
+	
+	Publish(m_SlotTable.load()->Slots(), locker);
+}
+
+//---- Publish slot table (caller holds slot mutex) ---------------------------
+
+	// retires the previous snapshot (see GracePeriod), a slot busy on another thread may itself (dis)connect
+	// masks are looked up among those already published, the same few subscriptions tend to come back
+
+void	LogSignal::Publish(const vector<LogSlot*> &slots, unique_lock<mutex> &locker)
+{
+	unique_ptr<const SlotMasks>	masks(new SlotMasks(slots));
+	
+	auto	it = find_if(m_MaskSets.begin(), m_MaskSets.end(), [&](const unique_ptr<const SlotMasks> &p){return *p == *masks;});
+	
+	if (m_MaskSets.end() == it)
+	{	m_MaskSets.push_back(std::move(masks));
+		it = m_MaskSets.end() - 1;
+	}
+	
+	m_SlotMasks.store(it->get(), memory_order_release);
+	
+	const SlotTable	*prev = m_SlotTable.exchange(new SlotTable(slots, it->get()), memory_order_seq_cst);
+	
+	// (subscriptions changed)
+	LogSite::BumpGeneration();
+	
+	const uint64_t	retire_epoch = s_Epochs.Advance();
+	
+	m_RetiredTables.emplace_back(retire_epoch, unique_ptr<const SlotTable>(prev));
+	
+	Reclaim(m_RetiredTables, GracePeriod(retire_epoch, locker));
+}
+
+//---- Disconnect All slots ---------------------------------------------------
+
+void	LogSignal::DisconnectAll(void)
+{
+	while (true)
+	{
+		LogSlot	*slot;
+		
+		{	unique_lock<mutex>	locker(m_SlotMutex);
+		
+			const vector<LogSlot*>	&slots = m_SlotTable.load()->Slots();
+			if (slots.empty())		break;
+			
+			slot = slots.back();
+		}
+		
+		Disconnect(slot);
+	}
+}
+
+//---- Thread Index registry --------------------------------------------------
+
+	// each logging thread grabs the lowest free index ONCE, cached in a thread_local,
+	// and gives it back on thread exit so thread pools recycle indices instead of growing a map
+
+namespace
+{
+
+class ThreadIndexRegistry
+{
+public:
+	static
+	ThreadIndexRegistry&	Get(void)
+	{
+		// leaked so a thread exiting after static destruction can still give its index back
+		static ThreadIndexRegistry	*s_Registry = new ThreadIndexRegistry();
+		
+		return *s_Registry;
+	}
+	
+	size_t	Acquire(void)
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		if (m_FreeSet.empty())		return m_NextIndex++;
+		
+		const size_t	index = *m_FreeSet.begin();
+		m_FreeSet.erase(m_FreeSet.begin());
+		
+		return index;
+	}
+	
+	void	Release(const size_t index)
+	{
+		unique_lock<mutex>	locker(m_Mutex);
+		
+		m_FreeSet.insert(index);
+	}
+	
+private:
+	
+	ThreadIndexRegistry()
+		: m_NextIndex(0)
+	{
+	}
+	
+	mutex		m_Mutex;
+	size_t		m_NextIndex;
+	set<size_t>	m_FreeSet;
+};
+
+struct ThreadIndexEntry
+{
+	ThreadIndexEntry()
+		: m_Index(ThreadIndexRegistry::Get().Acquire())
+	{
+	}
+	
+	~ThreadIndexEntry()
+	{
+		ThreadIndexRegistry::Get().Release(m_Index);
+	}
+	
+	const size_t	m_Index;
+};
+
+} // anonymous namespace
+
+	// (also where each logging thread gets its alternate signal stack once the crash handler
+	// is installed, see xtrap_fatal_thread)
+
+// static
+size_t	LogSignal::GetThreadIndex(void)
+{
+	static thread_local ThreadIndexEntry	s_Entry;
+	
+	xtrap_fatal_thread();
+	
+	return s_Entry.m_Index;
+}
+
+//---- Emit All ---------------------------------------------------------------
+
+	// triggers all connected slots
+
+	// the snapshot is stable for the whole pass; if this thread changed the list from inside
+	// a slot, slots no longer in the current list are skipped (and may already be gone)
+
+template<typename _Fn>
+void	LogSignal::ForEachSlot(const LogLevel lvl, _Fn fn) const
+{
+	EmitGuard	guard;
+	
+	const SlotTable	*table = m_SlotTable.load(memory_order_seq_cst);
+	
+	uint64_t	slot_mask = table->SlotMask(lvl);
+	
+	for (size_t i = 0; slot_mask; i++, slot_mask >>= 1)
+	{
+		if (!(slot_mask & 1))	continue;
+		
+		LogSlot	*slot = table->Slots()[i];
+		
+		const SlotTable	*cur_table = m_SlotTable.load(memory_order_acquire);
+		
+		if ((cur_table != table) && !cur_table->Has(slot))	continue;
+		
+		fn(slot);
+	}
+}
+
+void	LogSignal::EmitAll(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_index) const
+{
+	// no MUTEX: slots may re-log from inside, the slot list is a snapshot
+	
+	ForEachSlot(level, [&](LogSlot *slot){slot->LogAtLevel_LL(stamp, level, msg, thread_index);});
+}
+
+void	LogSignal::EmitAll(const LogRecord &rec) const
+{
+	ForEachSlot(rec.m_Level, [&](LogSlot *slot){slot->LogRecordAtLevel_LL(rec);});
+}
+
+//---- Has Slot For level -----------------------------------------------------
+
+	// no emit guard, published mask sets live as long as the signal
+
+bool	LogSignal::HasSlotFor(const LogLevel lvl) const
+{
+	return HasSlotForID(log_level_find(lvl));
+}
+
+bool	LogSignal::HasSlotForID(const LogLevelID id) const
+{
+	return m_SlotMasks.load(memory_order_acquire)->ForID(id) != 0;
+}
+
+//==== Async Log (rootLog's consumer thread) ==================================
+
+namespace LX
+{
+
+//---- Crash Record -----------------------------------------------------------
+
+	// fixed-size copy of a record still owned by the consumer, taken at crash time; a plain
+	// message is truncated, deferred/structured ones keep their packed args
+
+struct CrashRecord
+{
+	timestamp_t	m_Stamp;
+	LogLevel	m_Level;
+	size_t		m_ThreadIndex;
+	const char	*m_Fmt;
+	xargs		m_Args;
+	bool		m_FieldsFlag;
+	size_t		m_MsgLen;
+	char		m_Msg[LogLine::CRASH_LINE_MAX / 2];
+	
+	void	CopyFrom(const LogRecord &rec)
+	{
+		m_Stamp = rec.m_Stamp;
+		m_Level = rec.m_Level;
+		m_ThreadIndex = rec.m_ThreadIndex;
+		m_Fmt = rec.m_Fmt;
+		m_Args = rec.m_Args;
+		m_FieldsFlag = rec.m_FieldsFlag;
+		m_MsgLen = 0;
+		
+		if (m_Fmt || m_FieldsFlag)	return;
+		
+		m_MsgLen = std::min(rec.m_Msg.size(), sizeof(m_Msg));
+		::memcpy(m_Msg, rec.m_Msg.data(), m_MsgLen);
+	}
+};
+
+class AsyncLog
+{
+	static constexpr size_t	BATCH_SIZE = 256;
+	static constexpr int	IDLE_POLL_MS = 50;		// (backstop for missed wake-ups)
+	
+public:
+	// ctor
+	AsyncLog(const rootLog &root, const size_t queue_size, const LOG_OVERFLOW_T overflow)
+		: m_Root(root),
+		m_Queue(queue_size),
+		m_Overflow(overflow),
+		m_RunFlag(false),
+		m_ExitFlag(false),
+		m_IdleFlag(false),
+		m_Producers(0),
+		m_Dropped(0),
+		m_Processed(0),
+		m_ConsumerId{},
+		m_Batch(nil),
+		m_BatchNext(0),
+		m_BatchEnd(0)
+	{
+	}
+	// dtor
+	~AsyncLog()
+	{
+		Stop();
+	}
+	
+	void	Start(void)
+	{
+		if (m_RunFlag.load())	return;		// already running
+		
+		m_ExitFlag.store(false);
+		m_Thread = thread(&AsyncLog::Run, this);
+		m_RunFlag.store(true);
+	}
+	
+	void	Stop(void)
+	{
+		if (!m_RunFlag.exchange(false))		return;		// wasn't running
+		
+		// wait for in-flight producers to land their record
+		while (m_Producers.load() > 0)	this_thread::yield();
+		
+		// consumer drains what's left, then exits
+		m_ExitFlag.store(true);
+		Wake();
+		
+		m_Thread.join();
+	}
+	
+	bool	IsConsumerThread(void) const
+	{
+		return this_thread::get_id() == m_ConsumerId.load(memory_order_relaxed);
+	}
+	
+	//---- Push (any producer thread) ---------------------------------------------
+	
+		// returns false if record wasn't taken, caller should emit synchronously
+	
+	bool	Push(LogRecord &&rec)
+	{
+		m_Producers.fetch_add(1);
+		
+		if (!m_RunFlag.load())
+		{	// stopping or stopped
+			m_Producers.fetch_sub(1);
+			return false;
+		}
+		
+		bool	ok = m_Queue.try_push(std::move(rec));
+		
+		while (!ok)
+		{
+			if (LOG_OVERFLOW_T::DROP == m_Overflow)
+			{
+				m_Dropped.fetch_add(1, memory_order_relaxed);
+				ok = true;
+				break;
+			}
+			
+			if (IsConsumerThread())		break;		// slot re-logging into full queue would self-deadlock
+			
+			Wake();
+			this_thread::yield();
+			
+			ok = m_Queue.try_push(std::move(rec));
+		}
+		
+		// (pairs with consumer's fence after raising idle flag)
+		atomic_thread_fence(memory_order_seq_cst);
+		
+		if (m_IdleFlag.load(memory_order_relaxed))	Wake();
+		
+		m_Producers.fetch_sub(1, memory_order_release);
+		
+		return ok;
+	}
+	
+	//---- Flush ------------------------------------------------------------------
+	
+		// waits until everything queued so far was emitted
+	
+	void	Flush(void)
+	{
+		if (!m_RunFlag.load() || IsConsumerThread())	return;
+		
+		const size_t	target = m_Queue.pushed();
+		
+		unique_lock<mutex>	locker(m_WakeMutex);
+		
+		while (m_Processed.load() < target)
+		{
+			m_WakeCond.notify_one();
+			m_FlushCond.wait_for(locker, chrono::milliseconds(IDLE_POLL_MS));
+			
+			if (!m_RunFlag.load())	break;
+		}
+	}
+	
+	//---- Crash Visit (fatal signal handler only) ---------------------------------
+	
+		// records popped but not emitted yet (the one being emitted may come out twice),
+		// then those still queued; the consumer may still be running, so each one is copied
+		// to the stack and only handed to fn if its batch/cell didn't change meanwhile
+	
+	template<typename _Fn>
+	void	CrashVisit(_Fn fn) const
+	{
+		CrashRecord	rec;
+		
+		const size_t	processed = m_Processed.load(memory_order_acquire);
+		const LogRecord	*batch = m_Batch.load(memory_order_acquire);
+		const size_t	end = m_BatchEnd.load(memory_order_acquire);
+		
+		if (batch)
+		{
+			for (size_t i = m_BatchNext.load(memory_order_relaxed); i < end; i++)
+			{
+				rec.CopyFrom(batch[i]);
+				
+				atomic_thread_fence(memory_order_acquire);
+				
+				if ((m_BatchEnd.load(memory_order_relaxed) != end) || (m_Processed.load(memory_order_relaxed) != processed))
+					break;		// (batch done & being refilled)
+				
+				fn(rec);
+			}
+		}
+		
+		m_Queue.peek([&](const LogRecord &queued){rec.CopyFrom(queued);}, [&]{fn(rec);});
+	}
+	
+private:
+
+	void	Wake(void)
+	{
+		unique_lock<mutex>	locker(m_WakeMutex);
+		
+		m_WakeCond.notify_one();
+	}
+	
+	//---- consumer thread --------------------------------------------------------
+	
+	void	Run(void)
+	{
+		m_ConsumerId.store(this_thread::get_id());
+		
+		vector<LogRecord>	batch(BATCH_SIZE);
+		
+		m_Batch.store(batch.data(), memory_order_release);
+		
+		while (true)
+		{
+			size_t	n = 0;
+			
+			while ((n < BATCH_SIZE) && m_Queue.try_pop(batch[n]))	n++;
+			
+			if (n > 0)
+			{
+				Emit(batch, n);
+				continue;
+			}
+			
+			ReportDropped();
+			
+			if (m_ExitFlag.load())		break;		// (producers already gone)
+			
+			// idle
+			unique_lock<mutex>	locker(m_WakeMutex);
+			
+			m_IdleFlag.store(true, memory_order_relaxed);
+			atomic_thread_fence(memory_order_seq_cst);
+			
+			if (m_Queue.try_pop(batch[0]))
+			{
+				m_IdleFlag.store(false, memory_order_relaxed);
+				locker.unlock();
+				
+				Emit(batch, 1);
+				continue;
+			}
+			
+			if (!m_ExitFlag.load())
+				m_WakeCond.wait_for(locker, chrono::milliseconds(IDLE_POLL_MS));
+			
+			m_IdleFlag.store(false, memory_order_relaxed);
+		}
+		
+		m_Batch.store(nil);
+		m_ConsumerId.store(thread::id{});
+	}
+	
+	void	Emit(vector<LogRecord> &batch, const size_t n)
+	{
+		m_BatchEnd.store(n, memory_order_release);
+		
+		for (size_t i = 0; i < n; i++)
+		{
+			LogRecord	&rec = batch[i];
+			
+			m_BatchNext.store(i, memory_order_relaxed);
+		
+			m_Root.EmitAll(rec);
+				
+			rec.m_Msg.clear();		// (keeps capacity)
+			rec.m_Fmt = nil;
+			rec.m_Site = nil;
+			rec.m_FieldsFlag = false;
+		}
+		
+		m_BatchEnd.store(0, memory_order_relaxed);
+		m_Processed.fetch_add(n);
+		
+		// (orders the above before the next refill, for CrashVisit)
+		atomic_thread_fence(memory_order_release);
+		
+		unique_lock<mutex>	locker(m_WakeMutex);
+		
+		m_FlushCond.notify_all();
+	}
+	
+	void	ReportDropped(void)
+	{
+		const size_t	n_dropped = m_Dropped.exchange(0, memory_order_relaxed);
+		if (!n_dropped || !m_Root.IsLevelEnabled(WARNING))	return;
+		
+		const string	msg = xsprintf("async log queue full, dropped %zu record(s)", n_dropped);
+		
+		m_Root.EmitAll(timestamp_t{}, WARNING, msg, LogSignal::GetThreadIndex());
+	}
+	
+	const rootLog		&m_Root;
+	mpsc_queue<LogRecord>	m_Queue;
+	const LOG_OVERFLOW_T	m_Overflow;
+	
+	atomic<bool>		m_RunFlag;
+	atomic<bool>		m_ExitFlag;
+	atomic<bool>		m_IdleFlag;
+	atomic<size_t>		m_Producers;
+	atomic<size_t>		m_Dropped;
+	atomic<size_t>		m_Processed;
+	atomic<thread::id>	m_ConsumerId;
+	
+	// consumer's batch in progress, for crash-time drain
+	atomic<const LogRecord*>	m_Batch;
+	atomic<size_t>		m_BatchNext;
+	atomic<size_t>		m_BatchEnd;
+	
+	mutex			m_WakeMutex;
+	condition_variable	m_WakeCond;
+	condition_variable	m_FlushCond;
+	thread			m_Thread;
+};
+
+// (odr-used when bound to chrono ctor's const ref)
+constexpr size_t	AsyncLog::BATCH_SIZE;
+constexpr int		AsyncLog::IDLE_POLL_MS;
+
+//==== Level Table ============================================================
+
+	// immutable bitset of enabled level ids, published atomically by rootLog
+	// (enabling a tag registers it, so a tag without id is never enabled)
+
+class LevelTable
+{
+public:
+	// ctor
+	LevelTable(const unordered_set<LogLevel> &levels)
+		: m_Bits{}
+	{
+		for (const LogLevel lvl : levels)
+		{
+			const LogLevelID	id = log_level_id(lvl);
+			
+			if (id)		m_Bits.Set(id);
+		}
+	}
+	
+	bool	Has(const LogLevelID id) const
+	{
+		return m_Bits.Test(id);
+	}
+	
+	bool	operator==(const LevelTable &o) const
+	{
+		return m_Bits == o.m_Bits;
+	}
+	
+private:
+	
+	LogLevelBits	m_Bits;
+};
+
+} // namespace LX
+
+//==== rootLog (unique) ========================================================
+
+//---- CTOR -------------------------------------------------------------------
+
+	rootLog::rootLog()
+		: m_EnabledLevelSet{},
+		m_LevelTable{nil},
+		m_LevelLimits{},
+		m_LimitTable{nil},
+		m_AsyncLog{},
+		m_AsyncPtr{nil},
+		m_DeferredFlag{false}
+{
+	// (singleton)
+	call_once(s_root_log_once_f, [](rootLog *rl){s_rootLog.store(rl);}, this);
+	
+	EnableLevels({FATAL, EXCEPTION, LX_ERROR, WARNING, LX_MSG});		// msvc++ noise with PCH
+}
+	
+//---- DTOR -------------------------------------------------------------------
+
+	rootLog::~rootLog()
+{
+	// last suppressed-count summaries, then drain queue while slots are still connected
+	LogLimiter::StopReporter();
+	LogLimiter::ReportAll();
+	
+	StopAsync();
+	
+	// unpublish, then wait for threads still logging through the pointer
+	rootLog	*prev = s_rootLog.exchange(nil);
+	assert(prev == this);
+	(void)prev;
+	
+	LogSite::BumpGeneration();
+	
+	if (!EmitGuard::IsEmitting())
+		s_Epochs.Synchronize(s_Epochs.Advance(), nil);
+	
+	m_LevelTable.store(nil);		// (published tables go with m_LevelTables)
+	delete m_LimitTable.exchange(nil);
+}
+
+//----- Get Singleton instance ------------------------------------------------
+
+// static
+rootLog*rootLog::GetSingleton(void)
+{
+	return s_rootLog.load();
+}
+
+//----- Get Singleton reference -----------------------------------------------
+
+// static
+rootLog&	rootLog::Get(void)
+{
+	rootLog	*root = s_rootLog.load();
+	assert(root);
+	
+	return *root;
+}
+
+unordered_set<LogLevel>	rootLog::GetEnabledLevels(void) const
+{
+	unique_lock<mutex>	locker(m_LevelMutex);
+	
+	return m_EnabledLevelSet;
+}
+
+//---- Is Level Enabled (lock-free) -------------------------------------------
+
+bool	rootLog::IsLevelEnabled(const LogLevel lvl) const
+{
+	return IsLevelIDEnabled(log_level_find(lvl));
+}
+
+bool	rootLog::IsLevelIDEnabled(const LogLevelID id) const
+{
+	const LevelTable	*table = m_LevelTable.load(memory_order_acquire);
+	if (!table)		return false;
+	
+	return table->Has(id);
+}
+
+//---- Publish Levels (caller holds level mutex) ------------------------------
+
+	// rebuild & swap; readers take no guard, so tables are never freed before dtor and an
+	// identical one published earlier is re-used instead (toggling doesn't grow memory)
+
+void	rootLog::PublishLevels(void)
+{
+	unique_ptr<const LevelTable>	table(new LevelTable(m_EnabledLevelSet));
+	
+	auto	it = find_if(m_LevelTables.begin(), m_LevelTables.end(), [&](const unique_ptr<const LevelTable> &p){return *p == *table;});
+	
+	if (m_LevelTables.end() == it)
+	{	m_LevelTables.push_back(std::move(table));
+		it = m_LevelTables.end() - 1;
+	}
+	
+	m_LevelTable.store(it->get(), memory_order_release);
+	
+	LogSite::BumpGeneration();
+}
+
+//---- Publish Limits (caller holds level mutex) ------------------------------
+
+	// same as levels, a replaced limiter is retired along with the table that pointed to it
+
+void	rootLog::PublishLimits(unique_lock<mutex> &locker, unique_ptr<LogLimiter> replaced)
+{
+	LimitTable	*table = nil;
+	
+	if (!m_LevelLimits.empty())
+	{
+		table = new LimitTable;
+		
+		for (const auto &it : m_LevelLimits)
+		{
+			const LogLevelID	id = log_level_id(it.first);
+			if (!id)	continue;
+			
+			if (id >= table->size())	table->resize(id + 1, nil);
+			
+			(*table)[id] = it.second.get();
+		}
+	}
+	
+	const LimitTable	*prev = m_LimitTable.exchange(table, memory_order_seq_cst);
+	
+	if (!prev && !replaced)		return;
+	
+	const uint64_t	retire_epoch = s_Epochs.Advance();
+	
+	if (prev)	m_RetiredLimitTables.emplace_back(retire_epoch, unique_ptr<const LimitTable>(prev));
+	if (replaced)	m_RetiredLimiters.emplace_back(retire_epoch, std::move(replaced));
+	
+	const uint64_t	safe_epoch = GracePeriod(retire_epoch, locker);
+	
+	Reclaim(m_RetiredLimitTables, safe_epoch);
+	Reclaim(m_RetiredLimiters, safe_epoch);
+}
+
+
+//---- Has Log Level LOW-LEVEL ------------------------------------------------
+
+	// the disabled path: no guard, just acquire loads & bit tests on tables that outlive any
+	// caller (root itself is only gone at exit, as in every uLog() before the guard)
+
+// static
+bool	rootLog::HasLogLevel_LL(const LogLevel lvl)
+{
+	const rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root)		return false;		// not yet initialized or already exited
+	
+	// one id lookup for both tables
+	const LogLevelID	id = log_level_find(lvl);
+	
+	if (!root->IsLevelIDEnabled(id))	return false;
+	
+	// enabled but nobody listening: don't even format
+	const bool	f = root->HasSlotForID(id);
+	return f;
+}
+
+//---- Admit Level LOW-LEVEL --------------------------------------------------
+
+	// per-level rate limit / sampling, after level check & before formatting
+
+// static
+bool	rootLog::AdmitLevel_LL(const LogLevel lvl)
+{
+	EmitGuard	guard;
+	
+	const rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root)		return false;
+	
+	const LimitTable	*table = root->m_LimitTable.load(memory_order_seq_cst);
+	if (!table)		return true;		// no limits at all
+	
+	const LogLevelID	id = log_level_find(lvl);
+	
+	LogLimiter	*limiter = (id < table->size()) ? (*table)[id] : nil;
+	if (!limiter)		return true;
+	
+	return limiter->Admit(lvl);
+}
+
+//---- Do ULog LOW-LEVEL ------------------------------------------------------
+
+// static
+void	rootLog::DoULog_LL(const LogLevel lvl, string msg)
+{
+	EmitGuard	guard;
+	
+	rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root)		return;			// exited since level check
+	
+	root->DoULog(lvl, std::move(msg));
+}
+
+//---- Message Buffer LOW-LEVEL -----------------------------------------------
+
+// static
+string&	rootLog::MsgBuffer_LL(void)
+{
+	thread_local string	s_MsgBuff;
+	
+	s_MsgBuff.clear();
+	
+	return s_MsgBuff;
+}
+
+//---- Do ULog from Buffer LOW-LEVEL ------------------------------------------
+
+	// synchronous emission lends buff to the record and takes it back, so steady-state
+	// logging doesn't allocate; a queued record keeps it (re-logging slots get a fresh one)
+
+// static
+void	rootLog::DoULogBuffer_LL(const LogLevel lvl, string &buff, const LogSite *site)
+{
+	EmitGuard	guard;
+	
+	rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root || !root->IsLevelEnabled(lvl))	return;		// exited or level not enabled
+	
+	LogRecord	rec{timestamp_t{}, lvl, GetThreadIndex(), string{}, nil, xargs{}};
+	
+	rec.m_Msg.swap(buff);
+	rec.m_Site = site;
+	
+	AsyncLog	*async_log = root->m_AsyncPtr.load(memory_order_acquire);
+	
+	if (async_log && async_log->Push(std::move(rec)))	return;		// queued
+	
+	root->EmitAll(rec);
+	
+	buff.swap(rec.m_Msg);
+}
+
+//---- Do ULog ----------------------------------------------------------------
+
+void	rootLog::DoULog(const LogLevel lvl, string msg)
+{
+	if (!IsLevelEnabled(lvl))		return;		// level not enabled
+	
+	// need MUTEX ? -- NO, can re-enter???
+	
+	LogRecord	rec{timestamp_t{}, lvl, GetThreadIndex(), std::move(msg), nil, xargs{}};
+	
+	AsyncLog	*async_log = m_AsyncPtr.load(memory_order_acquire);
+	
+	if (async_log && async_log->Push(std::move(rec)))	return;		// queued
+	
+	EmitAll(rec);
+}
+
+//---- Is Deferred LOW-LEVEL --------------------------------------------------
+
+// static
+bool	rootLog::IsDeferred_LL(void)
+{
+	EmitGuard	guard;
+	
+	const rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root)		return false;
+	
+	return root->IsDeferredFormat();
+}
+
+//---- Do ULog Deferred LOW-LEVEL ---------------------------------------------
+
+	// format ptr & packed args are rendered by async consumer, or by the first slot needing text
+
+// static
+void	rootLog::DoULogDeferred_LL(const LogLevel lvl, const char *fmt, const xargs &args, const LogSite *site)
+{
+	assert(fmt);
+	
+	EmitGuard	guard;
+	
+	rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root)		return;
 	
-	auto	it = find(m_SlotList.begin(), m_SlotList.end(), slot);
-	assert(m_SlotList.end() != it);
+	LogRecord	rec{timestamp_t{}, lvl, GetThreadIndex(), string{}, fmt, args, site};
 	
-	// remove from list first so can log during disconnection (?)
-	m_SlotList.erase(it);
+	AsyncLog	*async_log = root->m_AsyncPtr.load(memory_order_acquire);
 	
-	slot->RemoveSignal();
+	if (async_log && async_log->Push(std::move(rec)))	return;		// queued
+	
+	root->EmitAll(rec);
 }
 
-//---- Disconnect All slots ---------------------------------------------------
-
-void	LogSignal::DisconnectAll(void)
-{
-	while (m_SlotList.size() > 0)
-	{
-		Disconnect(m_SlotList.back());
-	}
-}
+//---- Do ULog structured Fields LOW-LEVEL ------------------------------------
 
-//---- Get/update Thread Index ------------------------------------------------
+	// fields = message + (key, value) pairs, see uLogKV()
 
-size_t	LogSignal::GetThreadIndex(const thread::id thread_id) const
+// static
+void	rootLog::DoULogFields_LL(const LogLevel lvl, const xargs &fields)
 {
-	unique_lock<mutex>	locker(m_Mutex);
+	EmitGuard	guard;
 	
-	if (!m_ThreadIdMap.count(thread_id))
-		m_ThreadIdMap.emplace(thread_id, m_ThreadIdMap.size());
-		
-	const size_t	thread_index = m_ThreadIdMap.at(thread_id);
+	rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root)		return;
+	
+	LogRecord	rec{timestamp_t{}, lvl, GetThreadIndex(), string{}, nil, fields};
+	
+	rec.m_FieldsFlag = true;
+	
+	AsyncLog	*async_log = root->m_AsyncPtr.load(memory_order_acquire);
+	
+	if (async_log && async_log->Push(std::move(rec)))	return;		// queued
 	
-	return thread_index;
+	root->EmitAll(rec);
 }
 
-//---- Emit All ---------------------------------------------------------------
+//---- Start Async dispatch ---------------------------------------------------
 
-	// triggers all connected slots
+	// producers push into a bounded lock-free queue, a dedicated thread emits to slots in batches
+	// (queue size is fixed on 1st start)
 
-void	LogSignal::EmitAll(const timestamp_t stamp, const LogLevel level, const string &msg, const thread::id thread_id) const
+rootLog&	rootLog::StartAsync(const size_t queue_size, const LOG_OVERFLOW_T overflow)
 {
-	// need MUTEX ?
-	//   NO: if re-logs from a signal would lock up (?)
-	const size_t	thread_index = GetThreadIndex(thread_id);
+	if (!m_AsyncLog)
+		m_AsyncLog.reset(new AsyncLog(*this, queue_size, overflow));
 	
-	for (LogSlot *slot : m_SlotList)
-	{
-		slot->LogAtLevel_LL(stamp, level, msg, thread_index);
-	}
+	m_AsyncLog->Start();
+	
+	m_AsyncPtr.store(m_AsyncLog.get(), memory_order_release);
+	
+	return *this;
 }
 
-//==== rootLog (unique) ========================================================
+//---- Stop Async dispatch ----------------------------------------------------
 
-//---- CTOR -------------------------------------------------------------------
+	// drains queue, subsequent logs are emitted synchronously
 
-	rootLog::rootLog()
-		: m_EnabledLevelSet{}
+rootLog&	rootLog::StopAsync(void)
 {
-	// (singleton)
-	call_once(s_root_log_once_f, [](rootLog *rl){s_rootLog = rl;}, this);
+	if (!m_AsyncLog)	return *this;
 	
-	EnableLevels({FATAL, EXCEPTION, LX_ERROR, WARNING, LX_MSG});		// msvc++ noise with PCH
-}
+	m_AsyncPtr.store(nil, memory_order_release);
 	
-//---- DTOR -------------------------------------------------------------------
-
-	rootLog::~rootLog()
-{
-	assert(s_rootLog);
-	s_rootLog = nil;
+	// (late producers still holding the ptr fall back to sync emission)
+	m_AsyncLog->Stop();
+	
+	return *this;
 }
 
-//----- Get Singleton instance ------------------------------------------------
-
-// static
-rootLog*rootLog::GetSingleton(void)
+bool	rootLog::IsAsync(void) const
 {
-	return s_rootLog;
+	return m_AsyncPtr.load(memory_order_acquire) != nil;
 }
 
-//----- Get Singleton reference -----------------------------------------------
+//---- Set Deferred Formatting ------------------------------------------------
 
-// static
-rootLog&	rootLog::Get(void)
+	// uLog() then only copies its format ptr & args, string is rendered by the async consumer,
+	// or in sync mode by the first slot needing text (binary slots store raw args as-is)
+	// (only applies to literal formats and plain-old-data/string args)
+
+rootLog&	rootLog::SetDeferredFormat(const bool f)
 {
-	assert(s_rootLog);
+	m_DeferredFlag.store(f, memory_order_relaxed);
 	
-	return *s_rootLog;
+	return *this;
 }
 
-unordered_set<LogLevel>	rootLog::GetEnabledLevels(void) const
+bool	rootLog::IsDeferredFormat(void) const
 {
-	return m_EnabledLevelSet;
+	return m_DeferredFlag.load(memory_order_relaxed);
 }
 
+//---- Flush (wait for async queue to drain) ----------------------------------
 
-bool	rootLog::IsLevelEnabled(const LogLevel lvl) const
+void	rootLog::Flush(void)
 {
-	return m_EnabledLevelSet.count(lvl);
+	AsyncLog	*async_log = m_AsyncPtr.load(memory_order_acquire);
+	if (!async_log)		return;
+	
+	async_log->Flush();
 }
 
+//---- Install Crash Handler --------------------------------------------------
 
-//---- Has Log Level LOW-LEVEL ------------------------------------------------
+	// the handler runs on whichever thread crashed, which may hold any slot mutex,
+	// so it never locks, allocates nor throws and works off the current slot snapshot:
+	//   1) each file slot write()s out its pending buffer
+	//   2) async records not emitted yet are composed by each subscribed file slot,
+	//      deferred/structured ones as raw format/message text + hex packed args (no formatter)
+	//   3) a final marker line goes to all of them
+	// stamps use timestamp_t::crash_str(), i.e. the last local offset sampled
 
 // static
-bool	rootLog::HasLogLevel_LL(const LogLevel lvl)
+bool	rootLog::InstallCrashHandler(void)
 {
-	if (!s_rootLog)		return false;		// not yet initialized or already exited
+	char	stamp_s[STAMP_MAX_CHARS];
 	
-	const bool	f = s_rootLog->IsLevelEnabled(lvl);
-	return f;
+	timestamp_t{}.str(stamp_s, sizeof(stamp_s));		// samples local offset for crash_str()
+	
+	return xtrap_fatal(&rootLog::OnFatalSignal);
 }
 
-//---- Do ULog LOW-LEVEL ------------------------------------------------------
-
-// static
-void	rootLog::DoULog_LL(const LogLevel lvl, const string &msg)
+static
+size_t	AppendCrashMarker(char *buff, const size_t buff_size, const int sig)
 {
-	assert(s_rootLog);
+	const char	*sig_s = "signal";
 	
-	s_rootLog->DoULog(lvl, msg);
+	switch (sig)
+	{
+		case SIGSEGV:	sig_s = "SIGSEGV";	break;
+		case SIGABRT:	sig_s = "SIGABRT";	break;
+		case SIGFPE:	sig_s = "SIGFPE";	break;
+		case SIGILL:	sig_s = "SIGILL";	break;
+	#ifdef SIGBUS
+		case SIGBUS:	sig_s = "SIGBUS";	break;
+	#endif
+		default:	break;
+	}
+	
+	// (no snprintf in a signal handler)
+	char	num_s[16];
+	size_t	n_digits = 0;
+	
+	for (unsigned v = (sig > 0) ? sig : 0; (0 == n_digits) || v; v /= 10)
+		num_s[n_digits++] = '0' + (v % 10);
+	
+	xout	out(buff, buff_size);
+	
+	out.append("*** crashed on ", 15);
+	out.append(sig_s, ::strlen(sig_s));
+	out.append(" (", 2);
+	while (n_digits > 0)	out.push_back(num_s[--n_digits]);
+	out.append("), pending log records drained ***", 34);
+	
+	return std::min(out.size(), buff_size);
 }
 
-//---- Do ULog ----------------------------------------------------------------
+	// deferred: "<format> {args <hex>}", structured: "<message> {fields <hex>}"
+	// (bytes as packed by xargs, decodable offline, since the formatter isn't signal-safe)
 
-void	rootLog::DoULog(const LogLevel lvl, const string &msg)
+static
+size_t	AppendCrashRecord(char *buff, const size_t buff_size, const CrashRecord &rec)
 {
-	if (!IsLevelEnabled(lvl))		return;		// level not enabled
+	static const char	s_HexDigits[] = "0123456789abcdef";
 	
-	// need MUTEX ? -- NO, can re-enter???
+	xout		out(buff, buff_size);
+	size_t		pos = 0;
+	xarg_view	msg;
+	
+	if (rec.m_FieldsFlag && rec.m_Args.Next(pos, msg) && (XARG_T::STR == msg.m_Tag))
+	{
+		out.append(msg.m_Data, msg.m_Size);
+		out.append(" {fields ", 9);
+	}
+	else
+	{	pos = 0;
+		if (rec.m_Fmt)	out.append(rec.m_Fmt, ::strlen(rec.m_Fmt));
+		out.append(" {args ", 7);
+	}
+	
+	const char	*data = rec.m_Args.data();
+	
+	for (size_t i = pos; i < rec.m_Args.size(); i++)
+	{
+		out.push_back(s_HexDigits[(data[i] >> 4) & 0x0f]);
+		out.push_back(s_HexDigits[data[i] & 0x0f]);
+	}
+	
+	out.push_back('}');
+	
+	return std::min(out.size(), buff_size);
+}
+
+// static
+void	rootLog::OnFatalSignal(const int sig)
+{
+	const rootLog	*root = s_rootLog.load(memory_order_acquire);
+	if (!root)	return;
+	
+	const SlotTable		*table = root->m_SlotTable.load(memory_order_acquire);
+	const vector<LogSlot*>	&slots = table->Slots();
+	
+	uint64_t	sink_mask = 0;
+	
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (slots[i]->CrashFlush())	sink_mask |= (1ull << i);
+	}
+	
+	if (!sink_mask)		return;
+	
+	auto	crash_log = [&](const uint64_t mask, const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_index)
+	{
+		uint64_t	slot_mask = mask;
+		
+		for (size_t i = 0; slot_mask; i++, slot_mask >>= 1)
+		{
+			if (slot_mask & 1)	slots[i]->CrashLog(stamp, level, msg, len, thread_index);
+		}
+	};
+	
+	const AsyncLog	*async_log = root->m_AsyncPtr.load(memory_order_acquire);
+	
+	if (async_log)
+	{
+		async_log->CrashVisit([&](const CrashRecord &rec)
+		{
+			const uint64_t	mask = sink_mask & table->SlotMask(rec.m_Level);
+			if (!mask)	return;
+			
+			if (!rec.m_Fmt && !rec.m_FieldsFlag)
+			{	crash_log(mask, rec.m_Stamp, rec.m_Level, rec.m_Msg, rec.m_MsgLen, rec.m_ThreadIndex);
+				return;
+			}
+			
+			// deferred or structured, raw into stack buffer
+			char	msg[LogLine::CRASH_LINE_MAX / 2];
+			
+			crash_log(mask, rec.m_Stamp, rec.m_Level, msg, AppendCrashRecord(msg, sizeof(msg), rec), rec.m_ThreadIndex);
+		});
+	}
 	
-	const LX::timestamp_t	now{};
-	const thread::id	tid = this_thread::get_id();
+	char	marker[128];
 	
-	EmitAll(now, lvl, msg, tid);
+	crash_log(sink_mask, timestamp_t{}, FATAL, marker, AppendCrashMarker(marker, sizeof(marker), sig), 0);
 }
 
 //---- Clear All Log Levels ---------------------------------------------------
 
 rootLog&	rootLog::ClearAllLevels(void)
 {
+	unique_lock<mutex>	locker(m_LevelMutex);
+	
 	m_EnabledLevelSet.clear();
+	PublishLevels();
 	
 	return *this;
 }
@@ -249,26 +2001,70 @@ rootLog&	rootLog::ClearAllLevels(void)
 
 rootLog&	rootLog::EnableLevels(const unordered_set<LogLevel> &levels)
 {
+	unique_lock<mutex>	locker(m_LevelMutex);
+	
 	m_EnabledLevelSet.insert(levels.begin(), levels.end());
+	PublishLevels();
 	
 	return *this;
 }
 
 rootLog&	rootLog::EnableLevel(const char *level_s)
 {
+	// (by name, so a hash collision is caught)
+	log_level_register(level_s);
+	
 	return EnableLevels({log_hash(level_s)});
 }
 
+//---- Set Level Limit --------------------------------------------------------
+
+	// a fresh limiter replaces any previous one (which stays alive for in-flight callers)
+
+rootLog&	rootLog::SetLevelLimit(const LogLevel lvl, const LogLimit &limit)
+{
+	unique_lock<mutex>	locker(m_LevelMutex);
+	
+	unique_ptr<LogLimiter>	replaced(new LogLimiter(limit));
+	
+	m_LevelLimits[lvl].swap(replaced);
+	PublishLimits(locker, std::move(replaced));
+	
+	return *this;
+}
+
+rootLog&	rootLog::ClearLevelLimit(const LogLevel lvl)
+{
+	unique_lock<mutex>	locker(m_LevelMutex);
+	
+	unique_ptr<LogLimiter>	replaced;
+	
+	const auto	it = m_LevelLimits.find(lvl);
+	
+	if (m_LevelLimits.end() != it)
+	{	replaced = std::move(it->second);
+		m_LevelLimits.erase(it);
+	}
+	
+	PublishLimits(locker, std::move(replaced));
+	
+	return *this;
+}
+
 //---- Disable Log Levels -----------------------------------------------------
 
 rootLog&	rootLog::DisableLevels(const unordered_set<LogLevel> &levels)
 {
+	unique_lock<mutex>	locker(m_LevelMutex);
+	
 	// m_EnabledLevelSet.erase(levels.begin(), levels.end());		// doesn't work?
 	for (const auto lvl : levels)
 	{
 		m_EnabledLevelSet.erase(lvl);		
 	}
 	
+	PublishLevels();
+	
 	return *this;
 }
 
@@ -276,10 +2072,14 @@ rootLog&	rootLog::DisableLevels(const unordered_set<LogLevel> &levels)
 
 rootLog&	rootLog::ToggleLevel(const LogLevel lvl, const bool f)
 {
+	unique_lock<mutex>	locker(m_LevelMutex);
+	
 	if (f)
 		m_EnabledLevelSet.insert(lvl);
 	else	m_EnabledLevelSet.erase(lvl);
 	
+	PublishLevels();
+	
 	return *this;
 }
 
@@ -291,54 +2091,72 @@ public:
 	// ctor
 	FileLog(const string &fname, const STAMP_FORMAT fmt, const double min_elap_secs)
 		: LogSlot{},
-		m_Fmt(fmt),
-		m_MinSepElapSecs(min_elap_secs),
-		m_HexLevelFlag((fmt | STAMP_FORMAT::LEVEL) == fmt),
-		m_OFS {fname, ios_base::trunc}
+		m_FileName(fname),
+		m_LineComposer(fmt, min_elap_secs),
+		m_OFS {fname, ios_base::trunc},
+		m_CrashFD(-1)
 	{
 		assert(m_OFS && m_OFS.is_open());
 	}
 	// dtor
-	virtual ~FileLog()	{}
+	virtual ~FileLog()
+	{
+		DisconnectSelf();
+	}
 	
 	// IMP
 	void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) override
 	{
 		unique_lock<mutex>	locker(m_Mutex);
 		
-		const double	delta_secs = std::min(stamp.delta_secs(m_LastStamp), 80.0);
-		m_LastStamp = stamp;
+		// composed into reused buffer, flushed per line
+		m_Line.clear();
+		m_LineComposer.Compose(m_Line/*&*/, stamp, level, msg, thread_id);
 		
-		if (delta_secs > m_MinSepElapSecs)
-		{
-			const string	sep_s = string((size_t)delta_secs, '-');
+		m_OFS.write(m_Line.data(), m_Line.size());
+		m_OFS.flush();
+	}
+	
+	// IMP: lines are already flushed, crash-time lines are appended through a fresh fd
+	// (the ofstream's can't be had portably)
+	bool	CrashFlush(void) override
+	{
+		#ifdef WIN32
+			return false;
+		#else
+			m_CrashFD = ::open(m_FileName.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
 			
-			m_OFS << sep_s << endl;
-		}
-		
-		m_OFS << stamp.str(m_Fmt);
-
-		if (m_HexLevelFlag)
-			m_OFS << "|" << hex << setw(8) << setfill('0') << (int) level << "|";
-
-		if (thread_id > 0)
-		{
-			// OFF-THREAD
-			m_OFS << " _THREAD " << hex << thread_id << " : " << msg << endl;
-		}
-		else
-		{	m_OFS << " " << msg << endl;
-		}
+			return m_CrashFD >= 0;
+		#endif
+	}
+	
+	void	CrashLog(const timestamp_t stamp, const LogLevel level, const char *msg, const size_t len, const size_t thread_id) override
+	{
+		#ifndef WIN32
+			char	line[LogLine::CRASH_LINE_MAX];
+			
+			const size_t	n = m_LineComposer.CrashCompose(line, sizeof(line), stamp, level, msg, len, thread_id);
+			
+			for (size_t done = 0; done < n;)
+			{
+				const ssize_t	res = ::write(m_CrashFD, line + done, n - done);
+				
+				if (res > 0)			done += res;
+				else if (EINTR != errno)	break;
+			}
+		#else
+			(void)stamp; (void)level; (void)msg; (void)len; (void)thread_id;
+		#endif
 	}
 	
 private:
 	
-	const STAMP_FORMAT	m_Fmt;
-	const double		m_MinSepElapSecs;
-	const bool		m_HexLevelFlag;
+	const string		m_FileName;
+	LogLine			m_LineComposer;
+	string			m_Line;
 	mutable mutex		m_Mutex;
 	ofstream		m_OFS;
-	timestamp_t		m_LastStamp;
+	int			m_CrashFD;
 };
 
 //---- Cout Log ---------------------------------------------------------------
@@ -355,7 +2173,10 @@ public:
 	{
 	}
 	// dtor
-	virtual ~CoutLog()	{}
+	virtual ~CoutLog()
+	{
+		DisconnectSelf();
+	}
 	
 	// IMP
 	void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_id) override
@@ -374,13 +2195,17 @@ public:
 			m_OS << sep_s << endl;
 		}
 		
+		char	stamp_s[STAMP_MAX_CHARS];
+		
+		stamp.str(stamp_s, sizeof(stamp_s), m_Fmt);
+		
 		if (thread_id > 0)
 		{
 			// OFF-THREAD
-			m_OS << stamp.str(m_Fmt) << " _THREAD " << hex << thread_id << " : " << msg << endl;
+			m_OS << stamp_s << " _THREAD " << hex << thread_id << " : " << msg << endl;
 		}
 		else
-		{	m_OS << stamp.str(m_Fmt) << " " << msg << endl;
+		{	m_OS << stamp_s << " " << msg << endl;
 		}
 	}
 	
@@ -393,57 +2218,237 @@ private:
 	timestamp_t		m_LastStamp;
 };
 
+//---- Log Dedup --------------------------------------------------------------
+
+	// collapses repeats among a window of recent distinct messages, keyed on a 64-bit hash of
+	// (level, thread, text or deferred format & raw args) so there are no string compares
+	// the first occurrence goes through at once, repeats are counted and summarized as
+	// "<msg> [  Nx] in <time>" by a timer thread every flush period (or on eviction)
+	// keys include the thread, so windows are sharded by thread index and interleaved
+	// repeats from different threads don't share a mutex
+
 class LogDedup : public LogSlot
 {
+	static constexpr size_t	NUM_SHARDS = 16;
+	
+	struct Entry
+	{
+		uint64_t	m_Key = 0;
+		uint64_t	m_LastUse = 0;		// shard tick, 0 = unused
+		LogLevel	m_Level = LOG_NIL;
+		size_t		m_ThreadIndex = 0;
+		size_t		m_Repeats = 0;		// since last line
+		timestamp_t	m_FirstRepeat;
+		timestamp_t	m_LastRepeat;
+		string		m_Msg;			// text record (capacity reused)
+		const char	*m_Fmt = nil;		// or deferred record
+		xargs		m_Args;
+		bool		m_FieldsFlag = false;	// or structured record
+	};
+	
+	struct Shard
+	{
+		mutex		m_Mutex;
+		uint64_t	m_Tick = 0;
+		vector<Entry>	m_Window;
+	};
+	
+	struct Summary
+	{
+		timestamp_t	m_Stamp;
+		LogLevel	m_Level;
+		size_t		m_ThreadIndex;
+		string		m_Msg;
+	};
+	
 public:
-	LogDedup(LogSlot &next_slot)
-		: m_NextSlot(next_slot),
-		m_Level(LX_MSG),
-		m_ThreadIndex(0),
-		m_Cnt(0)
+	// ctor
+	LogDedup(LogSlot &next_slot, const int flush_ms, const size_t window)
+		: LogSlot{},
+		m_NextSlot(next_slot),
+		m_FlushMS(std::max(flush_ms, 1)),
+		m_ExitFlag(false)
+	{
+		// (window is split across shards)
+		const size_t	n_per_shard = std::max<size_t>(4, (window + NUM_SHARDS - 1) / NUM_SHARDS);
+		
+		for (Shard &shard : m_Shards)	shard.m_Window.resize(n_per_shard);
+		
+		m_FlushThread = thread(&LogDedup::FlushLoop, this);
+	}
+	// dtor
+	virtual ~LogDedup()
 	{
+		DisconnectSelf();
+		
+		{	unique_lock<mutex>	locker(m_FlushMutex);
+		
+			m_ExitFlag = true;
+		}
+		
+		m_FlushCond.notify_one();
+		m_FlushThread.join();
+		
+		Flush();
 	}
 	
+	// IMP
 	void	LogAtLevel(const timestamp_t stamp, const LogLevel level, const string &msg, const size_t thread_index) override
 	{
-		unique_lock<mutex>	locker(m_Mutex);
+		const uint64_t	key = Hash(Seed(level, thread_index), msg.data(), msg.size());
 		
-		if ((level == m_Level) && (msg == m_Msg) && (thread_index == m_ThreadIndex))
+		if (Admit(key, stamp, level, thread_index, [&](Entry &e){e.m_Msg.assign(msg); e.m_Fmt = nil; e.m_FieldsFlag = false;}))
+			m_NextSlot.LogAtLevel(stamp, level, msg, thread_index);
+	}
+	
+	// deferred records are keyed on format ptr & packed args, still not rendered
+	void	LogRecordAtLevel(const LogRecord &rec) override
+	{
+		if ((!rec.m_Fmt && !rec.m_FieldsFlag) || !rec.m_Msg.empty())
 		{
-			m_Cnt++;
+			LogAtLevel(rec.m_Stamp, rec.m_Level, rec.Msg(), rec.m_ThreadIndex);
+			return;
 		}
-		else
-		{
-			if (1 == m_Cnt)
+			
+		// (structured records have nil format)
+		uint64_t	key = Seed(rec.m_Level, rec.m_ThreadIndex);
+			
+		key = Hash(key, (const char*) &rec.m_Fmt, sizeof(rec.m_Fmt));
+		key = Hash(key, rec.m_Args.data(), rec.m_Args.size());
+		
+		if (Admit(key, rec.m_Stamp, rec.m_Level, rec.m_ThreadIndex, [&](Entry &e){e.m_Msg.clear(); e.m_Fmt = rec.m_Fmt; e.m_Args = rec.m_Args; e.m_FieldsFlag = rec.m_FieldsFlag;}))
+			m_NextSlot.LogRecordAtLevel(rec);
+	}
+
+private:
+
+	// FNV-1a
+	static
+	uint64_t	Hash(uint64_t h, const char *p, const size_t n)
+	{
+		for (size_t i = 0; i < n; i++)	h = (h ^ (uint8_t)p[i]) * 0x100000001b3ull;
+	
+		return h;
+	}
+	
+	static
+	uint64_t	Seed(const LogLevel level, const size_t thread_index)
+	{
+		const uint64_t	words[2] = {level, thread_index};
+		
+		return Hash(0xcbf29ce484222325ull, (const char*) words, sizeof(words));
+	}
+	
+	// true if first occurrence within window (caller forwards it)
+	template<typename _Fill>
+	bool	Admit(const uint64_t key, const timestamp_t stamp, const LogLevel level, const size_t thread_index, _Fill fill)
+	{
+		Shard	&shard = m_Shards[thread_index % NUM_SHARDS];
+		
+		Summary	evicted;
+		bool	evicted_f = false;
+		
+		{	unique_lock<mutex>	locker(shard.m_Mutex);
+		
+			const uint64_t	tick = ++shard.m_Tick;
+			
+			Entry	*victim = nil;
+			
+			for (Entry &e : shard.m_Window)
 			{
-				// send stored (current will become new stores
-				m_NextSlot.LogAtLevel(m_Stamp, m_Level, m_Msg, m_ThreadIndex);
+				if (e.m_LastUse && (e.m_Key == key))
+				{	// repeat
+					if (!e.m_Repeats)	e.m_FirstRepeat = stamp;
+					
+					e.m_Repeats++;
+					e.m_LastRepeat = stamp;
+					e.m_LastUse = tick;
+					return false;
+				}
+				
+				if (!victim || (e.m_LastUse < victim->m_LastUse))	victim = &e;
 			}
-			else if (m_Cnt != 0)
-			{	const string	cnt_msg = xsprintf("%s [%3zux] in %s", m_Msg, m_Cnt, m_Stamp.elap_str());
 			
-				m_NextSlot.LogAtLevel(m_Stamp, m_Level, cnt_msg, m_ThreadIndex);
+			// evict least recently used, flushing its repeats
+			if (victim->m_Repeats)
+			{	Summarize(*victim, evicted);
+				evicted_f = true;
 			}
 			
-			// reset
-			m_Stamp = stamp;
-			m_Level = level;
-			m_Msg = msg;
-			m_ThreadIndex = thread_index;
-			m_Cnt = 1;
+			victim->m_Key = key;
+			victim->m_LastUse = tick;
+			victim->m_Level = level;
+			victim->m_ThreadIndex = thread_index;
+			victim->m_Repeats = 0;
+			
+			fill(*victim);
 		}
+		
+		if (evicted_f)	m_NextSlot.LogAtLevel(evicted.m_Stamp, evicted.m_Level, evicted.m_Msg, evicted.m_ThreadIndex);
+		
+		return true;
 	}
-
-private:
-
-	LogSlot		&m_NextSlot;
-	mutable mutex	m_Mutex;
 	
-	timestamp_t	m_Stamp;
-	LogLevel	m_Level;
-	string		m_Msg;
-	size_t		m_ThreadIndex;
-	size_t		m_Cnt;
+	// (caller holds shard mutex)
+	static
+	void	Summarize(Entry &e, Summary &summary)
+	{
+		// (renders deferred text only now, errors are caught by the record)
+		const bool	packed_f = e.m_Fmt || e.m_FieldsFlag;
+		const LogRecord	rec{e.m_LastRepeat, e.m_Level, e.m_ThreadIndex, packed_f ? string{} : e.m_Msg, e.m_Fmt, packed_f ? e.m_Args : xargs{}, nil, e.m_FieldsFlag};
+		
+		summary.m_Stamp = e.m_LastRepeat;
+		summary.m_Level = e.m_Level;
+		summary.m_ThreadIndex = e.m_ThreadIndex;
+		summary.m_Msg = xsprintf("%s [%3zux] in %s", rec.Msg(), e.m_Repeats, ToHumanTime(e.m_LastRepeat.delta_secs(e.m_FirstRepeat), true/*ms*/));
+		
+		e.m_Repeats = 0;
+	}
+	
+	// emits all pending repeats, outside the shard mutexes (next slot may re-log)
+	void	Flush(void)
+	{
+		vector<Summary>	summaries;
+		
+		for (Shard &shard : m_Shards)
+		{
+			unique_lock<mutex>	locker(shard.m_Mutex);
+			
+			for (Entry &e : shard.m_Window)
+			{
+				if (!e.m_Repeats)	continue;
+				
+				summaries.emplace_back();
+				Summarize(e, summaries.back());
+			}
+		}
+		
+		for (const Summary &summary : summaries)
+			m_NextSlot.LogAtLevel(summary.m_Stamp, summary.m_Level, summary.m_Msg, summary.m_ThreadIndex);
+	}
+	
+	void	FlushLoop(void)
+	{
+		unique_lock<mutex>	locker(m_FlushMutex);
+		
+		while (!m_ExitFlag)
+		{
+			m_FlushCond.wait_for(locker, chrono::milliseconds(m_FlushMS));
+			
+			locker.unlock();
+			Flush();
+			locker.lock();
+		}
+	}
+	
+	LogSlot			&m_NextSlot;
+	const int		m_FlushMS;
+	Shard			m_Shards[NUM_SHARDS];
+	
+	mutex			m_FlushMutex;
+	condition_variable	m_FlushCond;
+	thread			m_FlushThread;
+	bool			m_ExitFlag;
 };
 
 //---- instantiate ------------------------------------------------------------
@@ -463,6 +2468,28 @@ LogSlot*	LogSlot::Create(const LOG_TYPE_T log_t, const string &fn, const STAMP_F
 			return new CoutLog(fmt, min_elap_secs);
 			break;
 		
+		case LOG_TYPE_T::BUFFERED_FILE:
+		
+			return CreateBuffered(fn, FLUSH_POLICY::INTERVAL, 500, fmt, min_elap_secs);
+			break;
+		
+		case LOG_TYPE_T::MMAP_FILE:
+		
+			return CreateMapped(fn, 16 * 1024 * 1024, fmt, min_elap_secs);
+			break;
+		
+		case LOG_TYPE_T::BINARY_FILE:
+		
+			// (stamp format is picked at decoding)
+			return CreateBinary(fn);
+			break;
+		
+		case LOG_TYPE_T::JSON_FILE:
+		
+			// (stamps are epoch microseconds)
+			return CreateJSON(fn);
+			break;
+		
 		default:
 		
 			return nil;
@@ -471,9 +2498,9 @@ LogSlot*	LogSlot::Create(const LOG_TYPE_T log_t, const string &fn, const STAMP_F
 }
 
 // static
-LogSlot*	LogSlot::CreateDedup(LogSlot &next_slot)
+LogSlot*	LogSlot::CreateDedup(LogSlot &next_slot, const int flush_ms, const size_t window)
 {
-	return new LogDedup(next_slot);
+	return new LogDedup(next_slot, flush_ms, window);
 }
 
 // nada mas
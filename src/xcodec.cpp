@@ -0,0 +1,345 @@
+// lx utils fast block codec
+
+/*
+
+block format (one sequence after another):
+
+	token		u8	high nibble = literal count, low nibble = match length - 4
+	[literal count extension]	255-bytes while saturated, then remainder
+	literals
+	offset		u16 LE	back-reference distance (absent in last sequence)
+	[match length extension]	same scheme as literals
+
+last sequence is literals only, last 5 bytes are always literals
+
+file format: "LXZ1", then blocks of
+	raw size	u32 LE
+	packed size	u32 LE	(== raw size means stored as-is)
+	data
+
+*/
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <memory>
+
+#include "lx/xcodec.h"
+
+using namespace std;
+using namespace LX;
+
+static const size_t	MIN_MATCH = 4;
+static const size_t	LAST_LITERALS = 5;
+static const size_t	MAX_OFFSET = 65535;
+static const int	HASH_BITS = 14;
+
+static const size_t	FILE_BLOCK_SIZE = 4 * 1024 * 1024;
+static const char	FILE_MAGIC[4] = {'L', 'X', 'Z', '1'};
+
+static inline
+uint32_t	Read32(const char *p)
+{
+	uint32_t	v;
+	
+	::memcpy(&v, p, sizeof(v));
+	
+	return v;
+}
+
+static inline
+uint32_t	Hash32(const uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static inline
+char*	PutLength(char *op, size_t len)
+{
+	while (len >= 255)
+	{
+		*op++ = (char) 255;
+		len -= 255;
+	}
+	
+	*op++ = (char) len;
+	
+	return op;
+}
+
+//---- Compress Bound ---------------------------------------------------------
+
+size_t	LX::LZCompressBound(const size_t n)
+{
+	return n + (n / 255) + 16;
+}
+
+//---- Compress ---------------------------------------------------------------
+
+size_t	LX::LZCompress(const char *src, const size_t n, char *dst, const size_t cap)
+{
+	if (cap < LZCompressBound(n))	return 0;
+	
+	vector<uint32_t>	table(1u << HASH_BITS, 0);
+	
+	const char	*ip = src;
+	const char	*anchor = src;
+	const char	*const end = src + n;
+	const char	*const match_limit = (n > LAST_LITERALS) ? end - LAST_LITERALS : src;
+	char		*op = dst;
+	
+	while ((ip + MIN_MATCH) <= match_limit)
+	{
+		const uint32_t	seq = Read32(ip);
+		uint32_t	&cell = table[Hash32(seq)];
+		const char	*ref = src + cell;
+		
+		cell = ip - src;
+		
+		if ((ref >= ip) || ((size_t)(ip - ref) > MAX_OFFSET) || (Read32(ref) != seq))
+		{
+			ip++;
+			continue;
+		}
+		
+		// extend match
+		size_t	match_len = MIN_MATCH;
+		
+		while (((ip + match_len) < match_limit) && (ref[match_len] == ip[match_len]))	match_len++;
+		
+		// token + literals
+		const size_t	lit_len = ip - anchor;
+		char		*token = op++;
+		
+		*token = (char) (((lit_len >= 15) ? 15 : lit_len) << 4);
+		
+		if (lit_len >= 15)	op = PutLength(op, lit_len - 15);
+		
+		::memcpy(op, anchor, lit_len);
+		op += lit_len;
+		
+		// offset + match length
+		const uint16_t	offset = ip - ref;
+		
+		*op++ = (char) (offset & 0xff);
+		*op++ = (char) (offset >> 8);
+		
+		const size_t	ml = match_len - MIN_MATCH;
+		
+		*token |= (char) ((ml >= 15) ? 15 : ml);
+		
+		if (ml >= 15)		op = PutLength(op, ml - 15);
+		
+		ip += match_len;
+		anchor = ip;
+	}
+	
+	// last literals
+	const size_t	lit_len = end - anchor;
+	
+	*op++ = (char) (((lit_len >= 15) ? 15 : lit_len) << 4);
+	
+	if (lit_len >= 15)	op = PutLength(op, lit_len - 15);
+	
+	::memcpy(op, anchor, lit_len);
+	op += lit_len;
+	
+	return op - dst;
+}
+
+//---- Decompress -------------------------------------------------------------
+
+size_t	LX::LZDecompress(const char *src, const size_t n, char *dst, const size_t cap)
+{
+	const size_t	CORRUPT = (size_t) -1;
+	
+	const uint8_t	*ip = (const uint8_t*) src;
+	const uint8_t	*const end = ip + n;
+	char		*op = dst;
+	char		*const op_end = dst + cap;
+	
+	while (ip < end)
+	{
+		const uint8_t	token = *ip++;
+		
+		// literals
+		size_t	lit_len = token >> 4;
+		
+		if (15 == lit_len)
+		{
+			uint8_t	b;
+			
+			do
+			{	if (ip >= end)		return CORRUPT;
+			
+				b = *ip++;
+				lit_len += b;
+			} while (255 == b);
+		}
+		
+		if (((size_t)(end - ip) < lit_len) || ((size_t)(op_end - op) < lit_len))	return CORRUPT;
+		
+		::memcpy(op, ip, lit_len);
+		ip += lit_len;
+		op += lit_len;
+		
+		if (ip == end)		break;		// last sequence
+		
+		// match
+		if ((end - ip) < 2)	return CORRUPT;
+		
+		const size_t	offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		
+		if ((0 == offset) || (offset > (size_t)(op - dst)))	return CORRUPT;
+		
+		size_t	match_len = token & 0x0f;
+		
+		if (15 == match_len)
+		{
+			uint8_t	b;
+			
+			do
+			{	if (ip >= end)		return CORRUPT;
+			
+				b = *ip++;
+				match_len += b;
+			} while (255 == b);
+		}
+		
+		match_len += MIN_MATCH;
+		
+		if ((size_t)(op_end - op) < match_len)		return CORRUPT;
+		
+		// (may overlap, copy forward byte-wise)
+		const char	*ref = op - offset;
+		
+		for (size_t i = 0; i < match_len; i++)	op[i] = ref[i];
+		
+		op += match_len;
+	}
+	
+	return op - dst;
+}
+
+//---- file helpers -----------------------------------------------------------
+
+namespace
+{
+
+struct FileCloser
+{
+	void	operator()(FILE *f) const	{if (f) ::fclose(f);}
+};
+
+using FilePtr = unique_ptr<FILE, FileCloser>;
+
+void	Put32(char *p, const uint32_t v)
+{
+	for (int i = 0; i < 4; i++)	p[i] = (char) (v >> (i * 8));
+}
+
+uint32_t	Get32(const char *p)
+{
+	uint32_t	v = 0;
+	
+	for (int i = 0; i < 4; i++)	v |= ((uint32_t)(uint8_t)p[i]) << (i * 8);
+	
+	return v;
+}
+
+} // anonymous namespace
+
+//---- Compress File ----------------------------------------------------------
+
+bool	LX::LZCompressFile(const string &src_fn, const string &dst_fn)
+{
+	FilePtr	in(::fopen(src_fn.c_str(), "rb"));
+	if (!in)		return false;
+	
+	FilePtr	out(::fopen(dst_fn.c_str(), "wb"));
+	if (!out)		return false;
+	
+	vector<char>	raw(FILE_BLOCK_SIZE);
+	vector<char>	packed(LZCompressBound(FILE_BLOCK_SIZE));
+	
+	bool	ok = (sizeof(FILE_MAGIC) == ::fwrite(FILE_MAGIC, 1, sizeof(FILE_MAGIC), out.get()));
+	
+	while (ok)
+	{
+		const size_t	n = ::fread(raw.data(), 1, raw.size(), in.get());
+		if (0 == n)	break;
+		
+		size_t		packed_sz = LZCompress(raw.data(), n, packed.data(), packed.size());
+		const char	*data = packed.data();
+		
+		if ((0 == packed_sz) || (packed_sz >= n))
+		{	// incompressible, store
+			packed_sz = n;
+			data = raw.data();
+		}
+		
+		char	hdr[8];
+		
+		Put32(&hdr[0], n);
+		Put32(&hdr[4], packed_sz);
+		
+		ok = (sizeof(hdr) == ::fwrite(hdr, 1, sizeof(hdr), out.get())) && (packed_sz == ::fwrite(data, 1, packed_sz, out.get()));
+	}
+	
+	ok &= !::ferror(in.get());
+	ok &= (0 == ::fflush(out.get()));
+	
+	return ok;
+}
+
+//---- Decompress File --------------------------------------------------------
+
+bool	LX::LZDecompressFile(const string &src_fn, const string &dst_fn)
+{
+	FilePtr	in(::fopen(src_fn.c_str(), "rb"));
+	if (!in)		return false;
+	
+	char	magic[sizeof(FILE_MAGIC)];
+	
+	if ((sizeof(magic) != ::fread(magic, 1, sizeof(magic), in.get())) || ::memcmp(magic, FILE_MAGIC, sizeof(magic)))
+		return false;
+	
+	FilePtr	out(::fopen(dst_fn.c_str(), "wb"));
+	if (!out)		return false;
+	
+	vector<char>	raw(FILE_BLOCK_SIZE);
+	vector<char>	packed(LZCompressBound(FILE_BLOCK_SIZE));
+	
+	while (true)
+	{
+		char	hdr[8];
+		
+		const size_t	n_hdr = ::fread(hdr, 1, sizeof(hdr), in.get());
+		if (0 == n_hdr)			break;		// clean EOF
+		if (sizeof(hdr) != n_hdr)	return false;
+		
+		const size_t	raw_sz = Get32(&hdr[0]);
+		const size_t	packed_sz = Get32(&hdr[4]);
+		
+		if ((raw_sz > raw.size()) || (packed_sz > packed.size()))		return false;
+		if (packed_sz != ::fread(packed.data(), 1, packed_sz, in.get()))	return false;
+		
+		const char	*data = packed.data();
+		
+		if (packed_sz != raw_sz)
+		{
+			if (raw_sz != LZDecompress(packed.data(), packed_sz, raw.data(), raw_sz))	return false;
+			
+			data = raw.data();
+		}
+		
+		if (raw_sz != ::fwrite(data, 1, raw_sz, out.get()))	return false;
+	}
+	
+	return (0 == ::fflush(out.get()));
+}
+
+// nada mas
@@ -33,6 +33,15 @@
 #include <iomanip>
 #include <iterator>			// for back_inserter on Windows
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define	LX_JSON_SSE2	1
+	
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
 #include "lx/xutils.h"
 
 // compile-time selection of int type with size of pointer
@@ -89,112 +98,235 @@ string	LX::ToHumanTime(const double secs, const bool ms_f)
 	const uint64_t	s = (tot_secs % 60);
 	const uint64_t	ms = tot_ms % 1000;
 	
-	if (ms_f)
-		return xsprintf("%02d:%02d:%02d.%03d", h, m, s, ms);
-	else	return xsprintf("%02d:%02d:%02d", h, m, s);
+	char	buff[64];
+	
+	const size_t	n = ms_f ? xsnprintf(buff, "%02d:%02d:%02d.%03d", h, m, s, ms) : xsnprintf(buff, "%02d:%02d:%02d", h, m, s);
+	
+	return string(buff, std::min(n, sizeof(buff) - 1));
 }
 
 //---- xsprintf() lowest specialization ---------------------------------------
 
-string	LX::xsprintf(const char *s)
+void	LX::xformatto(xout &out, const char *s)
 {
 	assert(s);
 	
-	outstream	ss;
-	
 	while (s && *s)
 	{
 		if ((*s == '%') && (*++s != '%'))	throw std::runtime_error("invalid format: missing argument in vanilla xsprintf()");
 		
-		ss << *s++;
+		out.push_back(*s++);
 	}
+}
 	
-	return ss.str();	
+string	LX::xsprintf(const char *s)
+{
+	string	res;
+	xout	out(res);
+	
+	xformatto(out, s);
+	
+	return res;
 }
 
-//---- handle xsprintf() prefix -----------------------------------------------
-
-	// (can't move() std::ostringstream cause isn't noexcept)
+//---- apply format spec to stream ------------------------------------------
 
-void	LX::xhandleprefix(const char *&s, outstream &ss)
+void	LX::xapplyspec(const xspec &spec, outstream &ss)
 {
-	assert(s);
-	
-	// vanilla chars
-	while (*s && (*s != '%'))	ss.put(*s++);
-	
-	if (0 == *s)
-	{	
-		throw runtime_error("arg overflow in xprintf()");
-	}
-	
-	assert('%' == *s);
+	// reset (stream may be reused across args)
+	ss.flags(ios_base::dec | ios_base::skipws);
+	ss.fill(' ');
+	ss.precision(6);
+	ss.width(0);
 	
-	// skip percent char
-	s++;
-	if (0 == *s)			throw runtime_error("truncated format in xprintf()");
+	if (spec.m_ShowPos)	ss << showpos;
 	
-	if ('%' == *s)
-	{	// double "%%", doesn't consume argument so don't follow normal code path
-		ss.put(*s++);
-		// recurse & step out
-		return xhandleprefix(s, ss);
+	if (spec.m_Precision >= 0)
+	{	// right-pad
+		ss << fixed << setprecision(spec.m_Precision);
 	}
 	
-	// check SIGN prefix
-	if ('+' == *s)
+	if (spec.m_Width > 0)
 	{
-		s++;
-		ss << showpos;
+		// front-pad with global width pad (left & right)
+		const int	total_pad = (spec.m_Precision > 0) ? (spec.m_Width + 1 + spec.m_Precision) : spec.m_Width;		// include '.' for width-pad
+		
+		ss << noskipws << setfill(spec.m_Fill) << setw(total_pad);
 	}
+}
+
+//---- handle xsprintf() prefix -----------------------------------------------
+
+xspec	LX::xhandleprefix(const char *&s, xout &out)
+{
+	assert(s);
 	
-	// check FILL prefix and WIDTH
-	const char	pad_char = isdigit(*s) ? (('0' == *s) ? '0' : ' ') : 0;
-	int		n_pad_left = 0;
+	for (;;)
+	{
+		// vanilla chars
+		const char	*p = s;
 	
-	while (isdigit(*s))
-		n_pad_left += (n_pad_left * 10) + (*s++ - '0');
+		while (*s && (*s != '%'))	s++;
 	
+		out.append(p, s - p);
 	
-	int	n_pad_right = -1;		// [no-right-pad]
+		if (0 == *s)
+		{	
+			throw runtime_error("arg overflow in xprintf()");
+		}
 	
-	if ('.' == *s)
-	{	
+		assert('%' == *s);
+		
+		// skip percent char
 		s++;
-		n_pad_right = 0;
+		if (0 == *s)			throw runtime_error("truncated format in xprintf()");
+		
+		if ('%' != *s)	break;
 		
-		while (isdigit(*s))
-			n_pad_right += (n_pad_right * 10) + (*s++ - '0');
+		// double "%%", doesn't consume argument
+		out.push_back(*s++);
 	}
 	
-	if (n_pad_right >= 0)
-	{	// right-pad
-		ss << fixed << setprecision(n_pad_right);
-	}
+	size_t		i = 0;
+	const xspec	spec = xparsespec(s, i/*&*/);
+	
+	s += i;
 	
-	if (n_pad_left > 0)
+	return spec;
+}
+
+//---- padded chars -----------------------------------------------------------
+
+	// ostream's default (right) adjustment, i.e. fill goes before any sign
+
+void	LX::xputchars(xout &out, const xspec &spec, const char *p, const size_t n)
+{
+	if (spec.m_Width > 0)
 	{
-		// front-pad with global width pad (left & right)
-		const int	total_pad = (n_pad_right > 0) ? (n_pad_left + 1 + n_pad_right) : n_pad_left;		// include '.' for width-pad
+		const size_t	total_pad = (spec.m_Precision > 0) ? (spec.m_Width + 1 + spec.m_Precision) : spec.m_Width;		// include '.' for width-pad
 		
-		ss << noskipws << setfill(pad_char) << setw(total_pad);
+		if (total_pad > n)	out.append(total_pad - n, spec.m_Fill);
 	}
 	
-	// skip any size specifier
-	switch (*s)
-	{	case 'z':		// size_t
-		case 'h':		// short / unsigned short
-		case 'l':		// long / unsigned long
-		case 'L':		// long double
+	out.append(p, n);
+}
+
+//---- integer ----------------------------------------------------------------
+
+void	LX::xputint(xout &out, const xspec &spec, const uint64_t mag, const bool neg_f, const bool signed_f, const int base)
+{
+	char		buff[24];
+	char		*end = buff + sizeof(buff);
+	char		*p = end;
+	uint64_t	v = mag;
 	
-			s++;
-			if (0 == *s)	throw runtime_error("incomplete size format specifier in xprintf()");
-			break;
-			
-		default:
+	if (base)
+	{
+		const char	*digits = (2 == base) ? "0123456789ABCDEF" : "0123456789abcdef";
 		
-			break;
+		do
+		{	*--p = digits[v & 0xf];
+			v >>= 4;
+		} while (v);
+	}
+	else
+	{
+		do
+		{	*--p = '0' + (v % 10);
+			v /= 10;
+		} while (v);
+		
+		// ostream only shows sign of signed decimals
+		if (neg_f)				*--p = '-';
+		else if (signed_f && spec.m_ShowPos)	*--p = '+';
 	}
+	
+	xputchars(out, spec, p, end - p);
+}
+
+//---- floating-point ---------------------------------------------------------
+
+	// as ostream: "%g" at precision 6 by default, fixed if precision was specified
+
+template<typename _T>
+static
+void	xputfloat_T(xout &out, const xspec &spec, const _T v, const char *len_s)
+{
+	char	fmt[8];
+	char	*f = fmt;
+	
+	*f++ = '%';
+	if (spec.m_ShowPos)	*f++ = '+';
+	*f++ = '.';
+	*f++ = '*';
+	while (*len_s)		*f++ = *len_s++;
+	*f++ = (spec.m_Precision >= 0) ? 'f' : 'g';
+	*f = 0;
+	
+	const int	prec = (spec.m_Precision >= 0) ? spec.m_Precision : 6;
+	
+	char		buff[64];
+	const int	n = ::snprintf(buff, sizeof(buff), fmt, prec, v);
+	
+	if (n < 0)	return;
+	
+	if ((size_t) n < sizeof(buff))
+	{	xputchars(out, spec, buff, n);
+		return;
+	}
+	
+	// huge fixed value
+	string	big(n + 1, 0);
+	
+	::snprintf(&big[0], big.size(), fmt, prec, v);
+	
+	xputchars(out, spec, big.data(), n);
+}
+
+void	LX::xputfloat(xout &out, const xspec &spec, const double v)
+{
+	xputfloat_T(out, spec, v, "");
+}
+
+void	LX::xputfloat(xout &out, const xspec &spec, const long double v)
+{
+	xputfloat_T(out, spec, v, "L");
+}
+
+//---- pointer ----------------------------------------------------------------
+
+void	LX::xputptr(xout &out, const xspec &spec, const void *p)
+{
+	static_assert(sizeof(p) == sizeof(PTR_INT_EQUIV), "unhandled pointer size");
+	
+	const PTR_INT_EQUIV	dbytes = static_cast<const char*>(p) - static_cast<const char*>(nullptr);
+	
+	// width pads the "0x" prefix, as xdump() does
+	xputchars(out, spec, "0x", 2);
+	
+	const xspec	num_spec{'x', false, '0', PTR_NUM_NYBBLES - 4, -1};
+	
+	xputint(out, num_spec, dbytes, false, false, 1);
+}
+
+//---- bool char --------------------------------------------------------------
+
+void	LX::xcharout(xout &out, const xspec &spec, const bool &b)
+{
+	if (b)	xputchars(out, spec, "true", 4);
+	else	xputchars(out, spec, "false", 5);
+}
+
+//---- thread id --------------------------------------------------------------
+
+void	LX::xdumpout(xout &out, const xspec &spec, const thread::id &thread_id, const int)
+{
+	outstream	ss;
+	
+	xapplyspec(spec, ss);
+	xdump(thread_id, ss);
+	
+	out.append(ss.str());
 }
 
 //---- int8_t specialization --------------------------------------------------
@@ -231,4 +363,320 @@ void	LX::xdump(const thread::id &thread_id, outstream &ss)
 	ss << hex << thread_id;
 }
 
+//==== deferred args ==========================================================
+
+bool	xargs::Put(const XARG_T tag, const void *p, const size_t sz)
+{
+	if ((m_Size + 1 + sz) > MAX_BYTES)	return false;		// overflow
+	
+	m_Buff[m_Size++] = (char) tag;
+	
+	::memcpy(&m_Buff[m_Size], p, sz);
+	m_Size += sz;
+	
+	return true;
+}
+
+bool	xargs::PutStr(const char *s, const size_t len)
+{
+	const uint16_t	len16 = len;
+	if ((len16 != len) || ((m_Size + 1 + sizeof(len16) + len) > MAX_BYTES))	return false;		// overflow
+	
+	m_Buff[m_Size++] = (char) XARG_T::STR;
+	
+	::memcpy(&m_Buff[m_Size], &len16, sizeof(len16));
+	m_Size += sizeof(len16);
+	
+	::memcpy(&m_Buff[m_Size], s, len);
+	m_Size += len;
+	
+	return true;
+}
+
+bool	xargs::PutStr(const char *s)
+{
+	return s ? PutStr(s, ::strlen(s)) : PutStr("", 0);
+}
+
+bool	xargs::PutStr(const string &s)
+{
+	return PutStr(s.data(), s.size());
+}
+
+//---- walk one packed arg ----------------------------------------------------
+
+	// returns false if malformed / truncated
+
+static
+bool	xargnext(const char *p, const size_t n, size_t &i, xarg_view &v)
+{
+	if (i >= n)	return false;
+	
+	v.m_Tag = (XARG_T) p[i++];
+	
+	size_t	sz = 0;
+	
+	switch (v.m_Tag)
+	{
+		case XARG_T::BOOL:	sz = sizeof(bool);		break;
+		case XARG_T::CHAR:
+		case XARG_T::I8:
+		case XARG_T::U8:	sz = 1;				break;
+		case XARG_T::I16:
+		case XARG_T::U16:	sz = 2;				break;
+		case XARG_T::I32:
+		case XARG_T::U32:	sz = 4;				break;
+		case XARG_T::I64:
+		case XARG_T::U64:	sz = 8;				break;
+		case XARG_T::F32:	sz = sizeof(float);		break;
+		case XARG_T::F64:	sz = sizeof(double);		break;
+		case XARG_T::F80:	sz = sizeof(long double);	break;
+		case XARG_T::PTR:	sz = sizeof(void*);		break;
+		
+		case XARG_T::STR:
+		{
+			uint16_t	len16;
+			
+			if ((i + sizeof(len16)) > n)	return false;
+			
+			::memcpy(&len16, &p[i], sizeof(len16));
+			i += sizeof(len16);
+			sz = len16;
+		}	break;
+		
+		default:
+		
+			return false;
+	}
+	
+	if ((i + sz) > n)	return false;
+	
+	v.m_Data = &p[i];
+	v.m_Size = sz;
+	
+	i += sz;
+	
+	return true;
+}
+
+//---- assign raw (validated) ------------------------------------------------
+
+bool	xargs::assign(const char *p, const size_t n)
+{
+	if (n > MAX_BYTES)	return false;
+	
+	// walk tags so Render() can't over-read
+	size_t		i = 0;
+	xarg_view	v;
+	
+	while (i < n)
+	{
+		if (!xargnext(p, n, i/*&*/, v))	return false;
+	}
+	
+	::memcpy(m_Buff, p, n);
+	m_Size = n;
+	
+	return true;
+}
+
+//---- Next packed arg --------------------------------------------------------
+
+bool	xargs::Next(size_t &pos, xarg_view &v) const
+{
+	return xargnext(m_Buff, m_Size, pos/*&*/, v);
+}
+
+//---- render one (plain) -----------------------------------------------------
+
+	// floats get the digits of their type (so 0.1f doesn't come out as 0.100000001)
+
+void	xarg_view::Render(xout &out) const
+{
+	const xspec	spec{'d', false, 0, 0, -1};
+	char		buff[64];
+	int		n = 0;
+	
+	switch (m_Tag)
+	{
+		case XARG_T::BOOL:	xcharout(out, spec, Get<bool>());			break;
+		case XARG_T::CHAR:	out.push_back(Get<char>());				break;
+		case XARG_T::I8:	xstreamout(out, spec, (int) Get<int8_t>(), 0);		break;
+		case XARG_T::U8:	xstreamout(out, spec, (unsigned) Get<uint8_t>(), 0);	break;
+		case XARG_T::I16:	xstreamout(out, spec, Get<int16_t>(), 0);		break;
+		case XARG_T::U16:	xstreamout(out, spec, Get<uint16_t>(), 0);		break;
+		case XARG_T::I32:	xstreamout(out, spec, Get<int32_t>(), 0);		break;
+		case XARG_T::U32:	xstreamout(out, spec, Get<uint32_t>(), 0);		break;
+		case XARG_T::I64:	xstreamout(out, spec, Get<int64_t>(), 0);		break;
+		case XARG_T::U64:	xstreamout(out, spec, Get<uint64_t>(), 0);		break;
+		case XARG_T::F32:	n = ::snprintf(buff, sizeof(buff), "%.7g", (double) Get<float>());	break;
+		case XARG_T::F64:	n = ::snprintf(buff, sizeof(buff), "%.15g", Get<double>());		break;
+		case XARG_T::F80:	n = ::snprintf(buff, sizeof(buff), "%.18Lg", Get<long double>());	break;
+		case XARG_T::PTR:	xputptr(out, spec, Get<void*>());			break;
+		case XARG_T::STR:	out.append(m_Data, m_Size);				break;
+		
+		default:
+		
+			break;
+	}
+	
+	if (n > 0)	out.append(buff, std::min<size_t>(n, sizeof(buff) - 1));
+}
+
+//---- render deferred args ---------------------------------------------------
+
+template<typename _T>
+static
+void	xformatraw(const char *&s, const char *&p, xout &out)
+{
+	_T	val;
+	
+	::memcpy(&val, p, sizeof(val));
+	p += sizeof(val);
+	
+	xformatarg(s/*&*/, val, out);
+}
+
+void	xargs::Render(const char *s, xout &out) const
+{
+	assert(s);
+	
+	const char	*p = m_Buff;
+	const char	*end = m_Buff + m_Size;
+	
+	while (p < end)
+	{
+		const XARG_T	tag = (XARG_T) *p++;
+		
+		switch (tag)
+		{
+			case XARG_T::BOOL:	xformatraw<bool>(s, p, out);		break;
+			case XARG_T::CHAR:	xformatraw<char>(s, p, out);		break;
+			case XARG_T::I8:	xformatraw<int8_t>(s, p, out);		break;
+			case XARG_T::U8:	xformatraw<uint8_t>(s, p, out);		break;
+			case XARG_T::I16:	xformatraw<int16_t>(s, p, out);		break;
+			case XARG_T::U16:	xformatraw<uint16_t>(s, p, out);	break;
+			case XARG_T::I32:	xformatraw<int32_t>(s, p, out);		break;
+			case XARG_T::U32:	xformatraw<uint32_t>(s, p, out);	break;
+			case XARG_T::I64:	xformatraw<int64_t>(s, p, out);		break;
+			case XARG_T::U64:	xformatraw<uint64_t>(s, p, out);	break;
+			case XARG_T::F32:	xformatraw<float>(s, p, out);		break;
+			case XARG_T::F64:	xformatraw<double>(s, p, out);		break;
+			case XARG_T::F80:	xformatraw<long double>(s, p, out);	break;
+			case XARG_T::PTR:	xformatraw<void*>(s, p, out);		break;
+			
+			case XARG_T::STR:
+			{
+				uint16_t	len16;
+				
+				::memcpy(&len16, p, sizeof(len16));
+				p += sizeof(len16);
+				
+				const string	str(p, len16);
+				p += len16;
+				
+				xformatarg(s/*&*/, str, out);
+			}	break;
+			
+			default:
+			
+				throw runtime_error("corrupt xargs in deferred xsprintf()");
+				break;
+		}
+	}
+	
+	xformatto(out, s);
+}
+
+string	xargs::Render(const char *s) const
+{
+	string	res;
+	xout	out(res);
+	
+	Render(s, out);
+	
+	return res;
+}
+
+//==== JSON string escape =====================================================
+
+static
+void	xputjsonchar(xout &out, const char c)
+{
+	static const char	s_HexDigits[] = "0123456789abcdef";
+	
+	switch (c)
+	{
+		case '"':	out.append("\\\"", 2);		break;
+		case '\\':	out.append("\\\\", 2);		break;
+		case '\n':	out.append("\\n", 2);		break;
+		case '\r':	out.append("\\r", 2);		break;
+		case '\t':	out.append("\\t", 2);		break;
+		case '\b':	out.append("\\b", 2);		break;
+		case '\f':	out.append("\\f", 2);		break;
+		
+		default:
+		{
+			const char	esc[6] = {'\\', 'u', '0', '0', s_HexDigits[(c >> 4) & 0x0f], s_HexDigits[c & 0x0f]};
+			
+			out.append(esc, sizeof(esc));
+		}	break;
+	}
+}
+
+static inline
+bool	xjsonclean(const char c)
+{
+	return ((unsigned char) c >= 0x20) && ('"' != c) && ('\\' != c);
+}
+
+void	LX::xputjson(xout &out, const char *p, const size_t n)
+{
+	size_t	i = 0, run = 0;			// [run, i) needs no escaping
+	
+	#if LX_JSON_SSE2
+		const __m128i	quote = _mm_set1_epi8('"');
+		const __m128i	bslash = _mm_set1_epi8('\\');
+		const __m128i	ctrl = _mm_set1_epi8(0x1f);
+		
+		while ((i + 16) <= n)
+		{
+			const __m128i	v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			
+			// (unsigned max(v, 0x1f) == 0x1f) <=> v <= 0x1f
+			const __m128i	hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)), _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+			const unsigned	mask = _mm_movemask_epi8(hit);
+			
+			if (!mask)
+			{	i += 16;
+				continue;
+			}
+			
+			#ifdef _MSC_VER
+				unsigned long	first;
+				_BitScanForward(&first, mask);
+			#else
+				const unsigned	first = __builtin_ctz(mask);
+			#endif
+			
+			i += first;
+			
+			out.append(p + run, i - run);
+			xputjsonchar(out, p[i++]);
+			run = i;
+		}
+	#endif
+	
+	for (; i < n; i++)
+	{
+		if (xjsonclean(p[i]))	continue;
+		
+		out.append(p + run, i - run);
+		xputjsonchar(out, p[i]);
+		run = i + 1;
+	}
+	
+	out.append(p + run, n - run);
+}
+
 // nada mas
@@ -10,10 +10,25 @@
 #include <iomanip>
 #include <stdexcept>
 #include <ctime>
+#include <cstdint>
+#include <algorithm>
 
 #include <cstring>
 
 #include <csignal>
+#include <atomic>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define	LX_TSC_CLOCK	1
+	
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+		#include <cpuid.h>
+	#endif
+#endif
 
 #ifdef WIN32
 	#include "Winsock.h"
@@ -133,6 +148,118 @@ void	LX::xtrap(const char *s)
 	#endif
 }
 
+//---- Fatal Signal Trap ------------------------------------------------------
+
+	// the first fatal signal runs the hook on an alternate stack (so a stack overflow
+	// can still be reported), then the default disposition is restored and the signal
+	// re-raised; a fault inside the hook, or on another thread meanwhile, takes the
+	// default path right away
+	// alternate stacks are per thread: the installing one gets it right away, others
+	// on their first xtrap_fatal_thread() call (freed on thread exit)
+
+#ifdef LOG_SIGNAL_TRAP
+
+static const int			s_FatalSignals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+static atomic<void (*)(const int)>	s_FatalHook{nullptr};
+static atomic_flag			s_FatalEnteredFlag = ATOMIC_FLAG_INIT;
+
+static
+void	OnFatalSignal(int sig)
+{
+	if (!s_FatalEnteredFlag.test_and_set())
+	{
+		void	(*hook)(const int) = s_FatalHook.load();
+		
+		if (hook)	hook(sig);
+	}
+	
+	::signal(sig, SIG_DFL);
+	::raise(sig);			// (delivered once handler returns)
+}
+
+constexpr size_t	FATAL_ALT_STACK_SIZE = 64 * 1024;
+
+struct fatal_alt_stack
+{
+	~fatal_alt_stack()
+	{
+		if (!m_Mem)	return;
+		
+		stack_t	ss{};
+		
+		ss.ss_flags = SS_DISABLE;
+		::sigaltstack(&ss, nullptr);
+		
+		delete [] m_Mem;
+	}
+	
+	char	*m_Mem = nullptr;
+	bool	m_Failed = false;
+};
+
+static thread_local fatal_alt_stack	s_FatalAltStack;
+
+#endif // LOG_SIGNAL_TRAP
+
+bool	LX::xtrap_fatal_thread(void)
+{
+	#ifdef LOG_SIGNAL_TRAP
+		fatal_alt_stack	&alt = s_FatalAltStack;
+		
+		if (alt.m_Mem)			return true;
+		if (alt.m_Failed || !s_FatalHook.load(memory_order_relaxed))	return false;
+		
+		alt.m_Mem = new char[FATAL_ALT_STACK_SIZE];
+		
+		stack_t	ss{};
+		
+		ss.ss_sp = alt.m_Mem;
+		ss.ss_size = FATAL_ALT_STACK_SIZE;
+		
+		if (0 != ::sigaltstack(&ss, nullptr))
+		{
+			delete [] alt.m_Mem;
+			alt.m_Mem = nullptr;
+			alt.m_Failed = true;
+			return false;
+		}
+		
+		return true;
+	#else
+		return false;
+	#endif
+}
+
+bool	LX::xtrap_fatal(void (*hook)(const int sig))
+{
+	#ifdef LOG_SIGNAL_TRAP
+		s_FatalHook.store(hook);
+		
+		if (!xtrap_fatal_thread())
+		{
+			s_FatalHook.store(nullptr);
+			return false;
+		}
+		
+		struct sigaction	sa{};
+		
+		sa.sa_handler = OnFatalSignal;
+		sa.sa_flags = SA_ONSTACK | SA_RESETHAND;
+		::sigemptyset(&sa.sa_mask);
+		
+		for (const int sig : s_FatalSignals)
+		{
+			if (0 != ::sigaction(sig, &sa, nullptr))	return false;
+		}
+		
+		return true;
+	#else
+		(void)hook;
+		
+		return false;
+	#endif
+}
+
 //---- Soft (non-spurious) String to Double conversion ------------------------
 
 double	LX::Soft_stod(const string &s, const double def)
@@ -199,8 +326,18 @@ uint32_t	LX::Soft_stoul(const string &s, const uint32_t def, const int base)
 
 //==== timestamp ==============================================================
 
-// static
-int64_t	timestamp_t::NowMicroSecs(void)
+	// clock sources behind NowMicroSecs(), selected process-wide by timestamp_t::SetClock()
+
+namespace
+{
+
+atomic<STAMP_CLOCK>	s_StampClock{STAMP_CLOCK::SYSTEM};
+atomic<int64_t>		s_MonotonicOffsetUS{0};			// wall - steady, when MONOTONIC was selected
+mutex			s_ClockMutex;				// (SetClock() only)
+
+using stampclock_t = system_clock;
+
+int64_t	SystemMicroSecs(void)
 {
 	#ifndef WIN32
 		const auto	tp = stampclock_t::now().time_since_epoch();
@@ -218,6 +355,245 @@ int64_t	timestamp_t::NowMicroSecs(void)
 	#endif
 }
 
+int64_t	SteadyMicroSecs(void)
+{
+	return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+#if defined(__linux__) && defined(CLOCK_REALTIME_COARSE)
+	#define	LX_COARSE_CLOCK	1
+	
+	int64_t	CoarseMicroSecs(void)
+	{
+		struct timespec	ts;
+		
+		::clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+		
+		return ((int64_t) ts.tv_sec * 1'000'000) + (ts.tv_nsec / 1'000);
+	}
+#endif
+
+#if LX_TSC_CLOCK
+
+//---- TSC clock --------------------------------------------------------------
+
+	// us = base_us + (tsc - base_tsc) * us_per_tick
+	// the base is published with a seqlock; whichever reader first sees it over a second old
+	// re-anchors it to the wall clock, refining the rate over the baseline since calibration
+
+class TSCClock
+{
+public:
+	static
+	bool	IsInvariant(void)
+	{
+		#ifdef _MSC_VER
+			int	regs[4];
+			
+			__cpuid(regs, 0x80000000);
+			if ((unsigned) regs[0] < 0x80000007u)	return false;
+			
+			__cpuid(regs, 0x80000007);
+			return (regs[3] & (1 << 8)) != 0;
+		#else
+			unsigned	eax, ebx, ecx, edx;
+			
+			if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || (eax < 0x80000007u))	return false;
+			if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))				return false;
+			
+			return (edx & (1u << 8)) != 0;
+		#endif
+	}
+	
+	// busy-waits a few millisecs, once
+	bool	Calibrate(void)
+	{
+		if (m_USPerTick.load() > 0)	return true;
+		
+		const int64_t	us0 = SystemMicroSecs();
+		const uint64_t	tsc0 = __rdtsc();
+		int64_t		us = us0;
+		
+		while ((us - us0) < CALIBRATION_US)	us = SystemMicroSecs();
+		
+		const uint64_t	tsc = __rdtsc();
+		
+		if (tsc <= tsc0)	return false;
+		
+		const double	us_per_tick = (double)(us - us0) / (tsc - tsc0);
+		
+		m_OrgTSC = tsc0;
+		m_OrgUS = us0;
+		m_ReanchorTicks = (uint64_t)(REANCHOR_US / us_per_tick);
+		
+		Publish(tsc, us, us_per_tick);
+		
+		return true;
+	}
+	
+	int64_t	Now(void)
+	{
+		const uint64_t	tsc = __rdtsc();
+		
+		for (;;)
+		{
+			uint32_t	seq = m_Seq.load(memory_order_acquire);
+			
+			if (seq & 1)	return SystemMicroSecs();		// being re-anchored (rare)
+			
+			const uint64_t	base_tsc = m_BaseTSC.load(memory_order_relaxed);
+			const int64_t	base_us = m_BaseUS.load(memory_order_relaxed);
+			const double	us_per_tick = m_USPerTick.load(memory_order_relaxed);
+			
+			atomic_thread_fence(memory_order_acquire);
+			
+			if (m_Seq.load(memory_order_relaxed) != seq)	continue;		// torn read
+			
+			const int64_t	d_ticks = (int64_t)(tsc - base_tsc);		// (may be slightly negative across cores)
+			
+			if ((d_ticks > (int64_t) m_ReanchorTicks) && m_Seq.compare_exchange_strong(seq, seq + 1, memory_order_acq_rel))
+				return Reanchor(us_per_tick);
+			
+			return base_us + (int64_t)(d_ticks * us_per_tick);
+		}
+	}
+	
+private:
+	
+	static constexpr int64_t	CALIBRATION_US = 10'000;
+	static constexpr double		REANCHOR_US = 1'000'000;
+	static constexpr double		MAX_RATE_DRIFT = 0.001;
+	
+	// seqlock is held (odd)
+	int64_t	Reanchor(const double old_us_per_tick)
+	{
+		atomic_thread_fence(memory_order_release);
+		
+		const int64_t	us = SystemMicroSecs();
+		const uint64_t	tsc = __rdtsc();
+		
+		double	us_per_tick = (double)(us - m_OrgUS) / (double)(tsc - m_OrgTSC);
+		
+		if (std::abs(us_per_tick - old_us_per_tick) > (old_us_per_tick * MAX_RATE_DRIFT))
+		{	// wall clock was adjusted, restart baseline
+			us_per_tick = old_us_per_tick;
+			m_OrgTSC = tsc;
+			m_OrgUS = us;
+		}
+		
+		m_BaseTSC.store(tsc, memory_order_relaxed);
+		m_BaseUS.store(us, memory_order_relaxed);
+		m_USPerTick.store(us_per_tick, memory_order_relaxed);
+		
+		m_Seq.fetch_add(1, memory_order_release);
+		
+		return us;
+	}
+	
+	void	Publish(const uint64_t tsc, const int64_t us, const double us_per_tick)
+	{
+		const uint32_t	seq = m_Seq.fetch_add(1, memory_order_acq_rel);
+		assert(!(seq & 1));
+		(void)seq;
+		
+		atomic_thread_fence(memory_order_release);
+		
+		m_BaseTSC.store(tsc, memory_order_relaxed);
+		m_BaseUS.store(us, memory_order_relaxed);
+		m_USPerTick.store(us_per_tick, memory_order_relaxed);
+		
+		m_Seq.fetch_add(1, memory_order_release);
+	}
+	
+	atomic<uint32_t>	m_Seq{0};
+	atomic<uint64_t>	m_BaseTSC{0};
+	atomic<int64_t>		m_BaseUS{0};
+	atomic<double>		m_USPerTick{0};
+	uint64_t		m_ReanchorTicks = 0;		// (set before TSC is selected)
+	
+	// rate baseline, re-anchoring thread only
+	uint64_t		m_OrgTSC = 0;
+	int64_t			m_OrgUS = 0;
+};
+
+constexpr int64_t	TSCClock::CALIBRATION_US;
+constexpr double	TSCClock::REANCHOR_US;
+constexpr double	TSCClock::MAX_RATE_DRIFT;
+
+TSCClock	s_TSCClock;
+
+#endif // LX_TSC_CLOCK
+
+} // anonymous namespace
+
+// static
+int64_t	timestamp_t::NowMicroSecs(void)
+{
+	switch (s_StampClock.load(memory_order_acquire))
+	{
+		#if LX_COARSE_CLOCK
+			case STAMP_CLOCK::REALTIME_COARSE:	return CoarseMicroSecs();
+		#endif
+		
+		#if LX_TSC_CLOCK
+			case STAMP_CLOCK::TSC:			return s_TSCClock.Now();
+		#endif
+		
+		case STAMP_CLOCK::MONOTONIC:		return SteadyMicroSecs() + s_MonotonicOffsetUS.load(memory_order_relaxed);
+		
+		default:				return SystemMicroSecs();
+	}
+}
+
+// static
+bool	timestamp_t::SetClock(const STAMP_CLOCK clk)
+{
+	lock_guard<mutex>	lock(s_ClockMutex);
+	
+	switch (clk)
+	{
+		case STAMP_CLOCK::SYSTEM:
+		
+			break;
+		
+		case STAMP_CLOCK::REALTIME_COARSE:
+		
+			#if LX_COARSE_CLOCK
+				break;
+			#else
+				return false;
+			#endif
+		
+		case STAMP_CLOCK::TSC:
+		
+			#if LX_TSC_CLOCK
+				if (!TSCClock::IsInvariant() || !s_TSCClock.Calibrate())	return false;
+				break;
+			#else
+				return false;
+			#endif
+		
+		case STAMP_CLOCK::MONOTONIC:
+		
+			s_MonotonicOffsetUS = SystemMicroSecs() - SteadyMicroSecs();
+			break;
+		
+		default:
+		
+			return false;
+	}
+	
+	s_StampClock = clk;
+	
+	return true;
+}
+
+// static
+STAMP_CLOCK	timestamp_t::GetClock(void)
+{
+	return s_StampClock.load();
+}
+
 	timestamp_t::timestamp_t(const int64_t &u_secs)
 		: m_usecs(u_secs)
 {
@@ -398,89 +774,310 @@ bool	any(STAMP_FORMAT o)
 
 //---- build timestamp STRING -------------------------------------------------
 
-	// could theoretically use format flag "%q" or "%Q" for millisecs but may barf depending on platform/country ?
+	// each thread caches the rendered "YYYY-MM-DD HH:MM:SS" of the last second it saw, so most
+	// lines only append sub-second digits; local time is UTC + an offset sampled via localtime_r()
+	// (which takes the process-wide tz lock) at most once per quarter-hour, since TZ/DST
+	// transitions fall on quarter-hour boundaries
+	// the last sampled offset is also kept process-wide for crash_str(), which can't take locks
 
-string	timestamp_t::str(const STAMP_FORMAT fmt0) const
+namespace
 {
-	const size_t	MAX_TIME_STAMP_CHARS = 128;
 	
-	try
-	{
-		/*
-		static
-		int	s_dTZ = 100;
-		
-		if (100 == s_dTZ)	s_dTZ = 0;						// (could compute TZ delta ONCE?)
-		*/
+const char	DIGIT_PAIRS[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+inline
+void	Put2(char *p, const unsigned v)
+{
+	::memcpy(p, &DIGIT_PAIRS[v * 2], 2);
+}
+
+inline
+void	Put3(char *p, const unsigned v)
+{
+	p[0] = '0' + (v / 100);
+	Put2(p + 1, v % 100);
+}
+
+int64_t	FloorDiv(const int64_t a, const int64_t b)
+{
+	return (a / b) - (((a % b) != 0) && ((a < 0) != (b < 0)));
+}
+
+// proleptic Gregorian, see H. Hinnant's "chrono-Compatible Low-Level Date Algorithms"
+int64_t	DaysFromCivil(int64_t y, const unsigned m, const unsigned d)
+{
+	y -= (m <= 2);
+	
+	const int64_t	era = FloorDiv(y, 400);
+	const unsigned	yoe = (unsigned)(y - (era * 400));
+	const unsigned	doy = ((153 * ((m > 2) ? (m - 3) : (m + 9))) + 2) / 5 + d - 1;
+	const unsigned	doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+	
+	return (era * 146097) + doe - 719468;
+}
+
+void	CivilFromDays(int64_t z, int64_t &y, unsigned &m, unsigned &d)
+{
+	z += 719468;
+	
+	const int64_t	era = FloorDiv(z, 146097);
+	const unsigned	doe = (unsigned)(z - (era * 146097));
+	const unsigned	yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+	const unsigned	doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+	const unsigned	mp = ((5 * doy) + 2) / 153;
+	
+	d = doy - (((153 * mp) + 2) / 5) + 1;
+	m = (mp < 10) ? (mp + 3) : (mp - 9);
+	y = yoe + (era * 400) + (m <= 2);
+}
+
+// local minus UTC, in secs
+int64_t	LocalOffsetSecs(const std::time_t secs)
+{
+	std::tm	tm_struct;
+	
+	#ifdef WIN32
+		_localtime64_s(&tm_struct, &secs);
+	#else
+		localtime_r(&secs, &tm_struct);
+	#endif
+	
+	const int64_t	local_secs = (DaysFromCivil(tm_struct.tm_year + 1900, tm_struct.tm_mon + 1, tm_struct.tm_mday) * 86400) + (tm_struct.tm_hour * 3600) + (tm_struct.tm_min * 60) + tm_struct.tm_sec;
+	
+	return local_secs - secs;
+}
+
+struct stamp_cache
+{
+	int64_t	m_Secs = INT64_MIN;		// (UTC) of text
+	size_t	m_DateLen = 0;			// "YYYY-MM-DD", followed by ' ' & "HH:MM:SS"
+	char	m_Text[32];
+};
+
+struct tz_cache
+{
+	int64_t	m_From = 1;			// [from, until) validity of offset, UTC secs
+	int64_t	m_Until = 0;
+	int64_t	m_Offset = 0;
+};
+
+thread_local stamp_cache	s_StampCache[2];		// [utc_f]
+thread_local tz_cache		s_TZCache;
+atomic<int64_t>			s_LastTZOffset{0};		// (any thread's, for crash_str)
+
+const int64_t	TZ_RECHECK_SECS = 15 * 60;
+
+// "YYYY-MM-DD HH:MM:SS" of local secs into p (needs 24 chars), returns date length
+// async-signal-safe: integer math only
+size_t	PutDateTime(char *p, const int64_t t)
+{
+	const int64_t	days = FloorDiv(t, 86400);
+	const unsigned	sod = (unsigned)(t - (days * 86400));
 		
-		char	buff[MAX_TIME_STAMP_CHARS];						// thread-safe but SLOWER
-		size_t	index = 0;
+	int64_t		y;
+	unsigned	m, d;
 		
-		const int64_t		t_us = GetUSecs();
-		const std::time_t	secs = t_us / 1'000'000ul;				// TERRIBLE resolution on windows?
+	CivilFromDays(days, y/*&*/, m/*&*/, d/*&*/);
+			
+	char	*org = p;
+
+	if ((y >= 1000) && (y <= 9999))
+	{	Put2(p, (unsigned)(y / 100));
+		Put2(p + 2, (unsigned)(y % 100));
+		p += 4;
+	}
+	else
+	{	// as "%04lld"
+		char		digits[20];
+		size_t		n = 0;
+		uint64_t	v = (y < 0) ? (0 - (uint64_t) y) : (uint64_t) y;
 		
-		const bool		utc_f = any(fmt0 & STAMP_FORMAT::UTC);
-		const STAMP_FORMAT	fmt = fmt0 & ~STAMP_FORMAT::UTC;
+		do
+		{	digits[n++] = '0' + (v % 10);
+			v /= 10;
+		} while (v);
 		
-		#ifdef WIN32
-			std::tm	tm_struct;
+		if (y < 0)	*p++ = '-';
+		for (size_t pad = (y < 0) ? 3 : 4; n < pad; pad--)	*p++ = '0';
+		while (n > 0)	*p++ = digits[--n];
+	}
 			
-			if (utc_f)
-				_gmtime64_s(&tm_struct, &secs/*__time64_t*/);
-			else	_localtime64_s(&tm_struct, &secs);
-
-			const auto	tm_p = &tm_struct;
-		#else
-			std::tm	tm_struct;
+	*p++ = '-';
+	Put2(p, m);
+	p += 2;
+	*p++ = '-';
+	Put2(p, d);
+	p += 2;
 			
-			if (utc_f)	gmtime_r(&secs, &tm_struct);
-			else		localtime_r(&secs, &tm_struct);
+	const size_t	date_len = p - org;
+	
+	*p++ = ' ';
+	Put2(p, sod / 3600);
+	p[2] = ':';
+	Put2(p + 3, (sod / 60) % 60);
+	p[5] = ':';
+	Put2(p + 6, sod % 60);
+	
+	return date_len;
+}
+
+void	RenderDateTime(stamp_cache &cache, const int64_t secs, const bool utc_f)
+{
+	int64_t	t = secs;
+	
+	if (!utc_f)
+	{
+		tz_cache	&tz = s_TZCache;
+		
+		if ((secs < tz.m_From) || (secs >= tz.m_Until))
+		{
+			tz.m_From = FloorDiv(secs, TZ_RECHECK_SECS) * TZ_RECHECK_SECS;
+			tz.m_Until = tz.m_From + TZ_RECHECK_SECS;
+			tz.m_Offset = LocalOffsetSecs(secs);
 			
-			const auto	tm_p = &tm_struct;
-		#endif		
+			s_LastTZOffset.store(tz.m_Offset, memory_order_relaxed);
+		}
+		
+		t += tz.m_Offset;
+	}
+	
+	cache.m_DateLen = PutDateTime(cache.m_Text, t);
+	cache.m_Secs = secs;
+}
+
+// sub-second digits, returns past end
+char*	PutSubSecs(char *p, const unsigned remain_us, const STAMP_FORMAT fmt)
+{
+	if (any(fmt & STAMP_FORMAT::MS))
+	{
+		*p++ = ':';
+		Put3(p, remain_us / 1'000);
+		p += 3;
+	}
+	
+	if (any(fmt & STAMP_FORMAT::US))
+	{
+		*p++ = ':';
+		Put3(p, remain_us % 1'000);
+		p += 3;
+	}
+	
+	return p;
+}
+
+// copies/truncates tmp to caller buffer if needed, NUL-terminates
+size_t	FinishStamp(char *buff, const size_t buff_size, const char *org, const char *end, const bool tmp_f)
+{
+	size_t	n = end - org;
+	
+	if (tmp_f)
+	{	n = std::min(n, buff_size - 1);
+		::memcpy(buff, org, n);
+	}
+	
+	buff[n] = 0;
+	
+	return n;
+}
+
+} // anonymous namespace
+
+size_t	timestamp_t::str(char *buff, const size_t buff_size, const STAMP_FORMAT fmt) const
+{
+	assert(buff && buff_size);
+	
+	char	tmp[STAMP_MAX_CHARS];
+	char	*p = (buff_size >= STAMP_MAX_CHARS) ? buff : tmp;		// (else truncated copy)
+	char	*org = p;
+	
+	const int64_t	t_us = GetUSecs();
+	const int64_t	secs = FloorDiv(t_us, 1'000'000);
+	const unsigned	remain_us = (unsigned)(t_us - (secs * 1'000'000));
+	const bool	utc_f = any(fmt & STAMP_FORMAT::UTC);
+	
+	if (any(fmt & (STAMP_FORMAT::YMD | STAMP_FORMAT::HMS)))
+	{
+		stamp_cache	&cache = s_StampCache[utc_f];
+		
+		if (cache.m_Secs != secs)	RenderDateTime(cache/*&*/, secs, utc_f);
 		
 		if (any(fmt & STAMP_FORMAT::YMD))
 		{
-			index += strftime(buff, sizeof(buff), "%Y-%m-%d", tm_p);
-			assert(index < MAX_TIME_STAMP_CHARS);
+			::memcpy(p, cache.m_Text, cache.m_DateLen);
+			p += cache.m_DateLen;
 		}
 		
 		if (any(fmt & STAMP_FORMAT::HMS))
 		{
-			if (any(fmt & STAMP_FORMAT::YMD))
-			{
-				buff[index++] = ' ';
-			}
+			if (any(fmt & STAMP_FORMAT::YMD))	*p++ = ' ';
 			
-			index += strftime(buff + index, sizeof(buff) - index, "%H:%M:%S", tm_p);
-			assert(index < MAX_TIME_STAMP_CHARS);
+			::memcpy(p, cache.m_Text + cache.m_DateLen + 1, 8);
+			p += 8;
 		}
+	}
+	
+	p = PutSubSecs(p, remain_us, fmt);
+	
+	assert((size_t)(p - org) < STAMP_MAX_CHARS);
+	
+	return FinishStamp(buff, buff_size, org, p, org == tmp);
+}
+
+size_t	timestamp_t::crash_str(char *buff, const size_t buff_size, const STAMP_FORMAT fmt) const noexcept
+{
+	if (0 == buff_size)	return 0;
+	
+	char	tmp[64];			// (room for any year of a garbled stamp)
+	char	*p = tmp;
+	char	*org = p;
+	
+	const int64_t	t_us = GetUSecs();
+	const int64_t	secs = FloorDiv(t_us, 1'000'000);
+	const unsigned	remain_us = (unsigned)(t_us - (secs * 1'000'000));
+	
+	if (any(fmt & (STAMP_FORMAT::YMD | STAMP_FORMAT::HMS)))
+	{
+		const int64_t	offset = any(fmt & STAMP_FORMAT::UTC) ? 0 : s_LastTZOffset.load(memory_order_relaxed);
+		char		text[32];
+		const size_t	date_len = PutDateTime(text, secs + offset);
 		
-		const unsigned int	remain_ms = (t_us - ((int64_t) secs * 1'000'000ul)) / 1'000ul;		// must typecast UP or goes to shit on x32
-		
-		if (any(fmt & STAMP_FORMAT::MS))
+		if (any(fmt & STAMP_FORMAT::YMD))
 		{
-			index += snprintf(buff + index, sizeof(buff) - index, ":%03u", remain_ms);
-			assert(index < MAX_TIME_STAMP_CHARS);
+			::memcpy(p, text, date_len);
+			p += date_len;
 		}
 		
-		if (any(fmt & STAMP_FORMAT::US))
+		if (any(fmt & STAMP_FORMAT::HMS))
 		{
-			const unsigned int	remain_us = t_us % 1'000ul;
-		
-			index += snprintf(buff + index, sizeof(buff) - index, ":%03u", remain_us);
-			assert(index < MAX_TIME_STAMP_CHARS);
+			if (any(fmt & STAMP_FORMAT::YMD))	*p++ = ' ';
+			
+			::memcpy(p, text + date_len + 1, 8);
+			p += 8;
 		}
-		
-		return string(buff, buff + index);
-	}
-	catch (...)
-	{
-		// apparently fickly
-		assert(0);
 	}
 	
-	return string("<failed>");
+	p = PutSubSecs(p, remain_us, fmt);
+	
+	return FinishStamp(buff, buff_size, org, p, true);
+}
+
+string	timestamp_t::str(const STAMP_FORMAT fmt) const
+{
+	char	buff[STAMP_MAX_CHARS];
+	
+	const size_t	n = str(buff, sizeof(buff), fmt);
+	
+	return string(buff, n);
 }
 
 // nada mas
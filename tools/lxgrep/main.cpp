@@ -0,0 +1,454 @@
+// lxgrep - parallel literal search over text logs, filtered by level & thread index
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#ifndef WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#define	LX_GREP_SSE2	1
+	
+	#include <emmintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#endif
+#endif
+
+#include "lx/ulog.h"
+
+using namespace std;
+using namespace LX;
+
+// lines are cut into chunks of about this size, each scanned by one thread
+constexpr size_t	CHUNK_BYTES = 4 * 1024 * 1024;
+
+static
+void	Usage(void)
+{
+	::fprintf(stderr,
+		"usage: lxgrep [options] <pattern> <file>...\n"
+		"  <pattern>         literal substring, \"\" matches every line\n"
+		"  -l <tag>[,<tag>]  levels by name (e.g. LX_ERROR,WARNING) or 0x<hash>, needs the hex level column (STAMP_FORMAT::LEVEL)\n"
+		"  -t <index>[,...]  thread indices (0 = logged on the main thread)\n"
+		"  -c                print count of matching lines only\n"
+		"  -j <threads>      scanning threads (default: all cores)\n");
+}
+
+//---- read-only file mapping -------------------------------------------------
+
+class mapped_file
+{
+public:
+	explicit mapped_file(const string &fn)
+		: m_Data(nil), m_Size(0)
+	{
+		#ifdef WIN32
+			ifstream	ifs(fn, ios_base::binary);
+			if (!ifs)	return;
+			
+			m_Copy.assign(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+			m_Data = m_Copy.data();
+			m_Size = m_Copy.size();
+			m_OK = true;
+		#else
+			const int	fd = ::open(fn.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd < 0)	return;
+			
+			struct stat	st;
+			
+			if ((0 == ::fstat(fd, &st)) && (st.st_size > 0))
+			{
+				void	*p = ::mmap(nil, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				
+				if (MAP_FAILED != p)
+				{
+					::madvise(p, st.st_size, MADV_SEQUENTIAL);
+					
+					m_Data = (const char*) p;
+					m_Size = st.st_size;
+				}
+			}
+			
+			m_OK = (0 == st.st_size) || m_Data;
+			
+			::close(fd);
+		#endif
+	}
+	// dtor
+	~mapped_file()
+	{
+		#ifndef WIN32
+			if (m_Data)	::munmap((void*) m_Data, m_Size);
+		#endif
+	}
+	
+	bool		ok(void) const		{return m_OK;}
+	const char*	data(void) const	{return m_Data;}
+	size_t		size(void) const	{return m_Size;}
+
+private:
+
+	const char	*m_Data;
+	size_t		m_Size;
+	bool		m_OK = false;
+	
+	#ifdef WIN32
+		string	m_Copy;
+	#endif
+};
+
+//---- substring search -------------------------------------------------------
+
+	// 16 candidate positions at a time whose first AND last bytes match the pattern's,
+	// only those are compared in full, so rare first/last byte pairs skip most of the text
+
+static
+size_t	FindSubstr(const char *p, const size_t n, const string &pat)
+{
+	const size_t	m = pat.size();
+	
+	if (m > n)	return string::npos;
+	
+	if (m <= 1)
+	{
+		if (0 == m)	return 0;
+		
+		const char	*q = (const char*) ::memchr(p, pat[0], n);
+		
+		return q ? (q - p) : string::npos;
+	}
+	
+	const size_t	last = n - m;			// last valid start
+	size_t		i = 0;
+	
+	#if LX_GREP_SSE2
+		const __m128i	first_v = _mm_set1_epi8(pat[0]);
+		const __m128i	last_v = _mm_set1_epi8(pat[m - 1]);
+		
+		for (; (i + 15) <= last; i += 16)
+		{
+			const __m128i	b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+			const __m128i	b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + m - 1));
+			
+			unsigned	mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(b0, first_v), _mm_cmpeq_epi8(b1, last_v)));
+			
+			while (mask)
+			{
+				#ifdef _MSC_VER
+					unsigned long	k;
+					_BitScanForward(&k, mask);
+				#else
+					const unsigned	k = __builtin_ctz(mask);
+				#endif
+				
+				if (0 == ::memcmp(p + i + k + 1, pat.data() + 1, m - 2))	return i + k;
+				
+				mask &= mask - 1;
+			}
+		}
+	#endif
+	
+	for (; i <= last; i++)
+	{
+		const char	*q = (const char*) ::memchr(p + i, pat[0], last - i + 1);
+		if (!q)		break;
+		
+		i = q - p;
+		
+		if ((p[i + m - 1] == pat[m - 1]) && (0 == ::memcmp(p + i + 1, pat.data() + 1, m - 2)))	return i;
+	}
+	
+	return string::npos;
+}
+
+//---- line filter ------------------------------------------------------------
+
+	// lines are "<stamp>[|<hex level>|][ _THREAD <hex index> :] msg", continuation lines of
+	// multi-line messages have neither column so only match when nothing is filtered
+
+class LineFilter
+{
+public:
+	LineFilter(const vector<LogLevel> &levels, const vector<size_t> &threads)
+		: m_Levels(levels), m_Threads(threads)
+	{
+	}
+	
+	bool	IsNil(void) const	{return m_Levels.empty() && m_Threads.empty();}
+	
+	bool	Match(const char *p, const size_t n) const
+	{
+		if (IsNil())	return true;
+		
+		// (columns are within the head)
+		const size_t	head = std::min(n, STAMP_MAX_CHARS + 10 + 9);
+		size_t		pos = 0;
+		
+		if (!m_Levels.empty())
+		{
+			const char	*bar = (const char*) ::memchr(p, '|', head);
+			
+			if (!bar || ((size_t) (bar - p) + 10 > n) || ('|' != bar[9]))	return false;
+			
+			const LogLevel	lvl = Soft_stoul(string(bar + 1, 8), 0, 16);
+			
+			if (m_Levels.end() == std::find(m_Levels.begin(), m_Levels.end(), lvl))	return false;
+			
+			pos = (bar - p) + 10;
+		}
+		
+		if (!m_Threads.empty())
+		{
+			size_t	index = 0;
+			
+			for (size_t i = pos; (i + 10) < head; i++)
+			{
+				if (::memcmp(p + i, " _THREAD ", 9))	continue;
+				
+				size_t	j = i + 9;
+				
+				while ((j < n) && isxdigit((unsigned char)p[j]))	index = (index * 16) + HexDigit(p[j++]);
+				break;
+			}
+			
+			if (m_Threads.end() == std::find(m_Threads.begin(), m_Threads.end(), index))	return false;
+		}
+		
+		return true;
+	}
+
+private:
+
+	static
+	unsigned	HexDigit(const char c)
+	{
+		return (c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10);
+	}
+	
+	const vector<LogLevel>	&m_Levels;
+	const vector<size_t>	&m_Threads;
+};
+
+//---- chunk scan -------------------------------------------------------------
+
+	// appends matching lines (with prefix) to out, returns their count
+
+static
+size_t	ScanChunk(const char *p, const size_t n, const string &pat, const LineFilter &filter, const string &prefix, const bool count_f, string &out)
+{
+	size_t	n_matches = 0;
+	
+	auto	emit = [&](const size_t start, const size_t end)
+	{
+		n_matches++;
+		
+		if (count_f)	return;
+		
+		out.append(prefix);
+		out.append(p + start, end - start);
+		
+		if ('\n' != p[end - 1])		out.push_back('\n');
+	};
+	
+	for (size_t pos = 0; pos < n; )
+	{
+		size_t	start = pos;
+		
+		if (!pat.empty())
+		{
+			const size_t	hit = FindSubstr(p + pos, n - pos, pat);
+			if (string::npos == hit)	break;
+			
+			// back to line start
+			start = pos + hit;
+			
+			while ((start > pos) && ('\n' != p[start - 1]))		start--;
+		}
+		
+		const char	*nl = (const char*) ::memchr(p + start, '\n', n - start);
+		const size_t	end = nl ? ((nl - p) + 1) : n;
+		
+		if (filter.Match(p + start, end - start))	emit(start, end);
+		
+		pos = end;
+	}
+	
+	return n_matches;
+}
+
+static
+bool	ParseLevels(const string &s, vector<LogLevel> &levels)
+{
+	size_t	pos = 0;
+	
+	while (pos <= s.size())
+	{
+		size_t	end = s.find(',', pos);
+		if (string::npos == end)	end = s.size();
+		
+		const string	tag = s.substr(pos, end - pos);
+		
+		if (tag.empty())	return false;
+		
+		if (!tag.compare(0, 2, "0x"))
+			levels.push_back(Soft_stoul(tag.substr(2), 0, 16));
+		else	levels.push_back(log_hash(tag.c_str()));
+		
+		pos = end + 1;
+	}
+	
+	return true;
+}
+
+static
+bool	ParseThreads(const string &s, vector<size_t> &threads)
+{
+	size_t	pos = 0;
+	
+	while (pos <= s.size())
+	{
+		size_t	end = s.find(',', pos);
+		if (string::npos == end)	end = s.size();
+		
+		const int	index = Soft_stoi(s.substr(pos, end - pos), -1);
+		
+		if (index < 0)		return false;
+		
+		threads.push_back(index);
+		
+		pos = end + 1;
+	}
+	
+	return true;
+}
+
+int	main(int argc, char *argv[])
+{
+	vector<LogLevel>	levels;
+	vector<size_t>		threads;
+	bool			count_f = false, pat_f = false;
+	size_t			n_threads = std::max(1u, thread::hardware_concurrency());
+	string			pat;
+	vector<string>		files;
+	
+	for (int i = 1; i < argc; i++)
+	{
+		const string	arg(argv[i]);
+		
+		if (("-l" == arg) && ((i + 1) < argc) && ParseLevels(argv[++i], levels))	{}
+		else if (("-t" == arg) && ((i + 1) < argc) && ParseThreads(argv[++i], threads))	{}
+		else if ("-c" == arg)		count_f = true;
+		else if (("-j" == arg) && ((i + 1) < argc))	n_threads = std::max(1, Soft_stoi(argv[++i], 1));
+		else if (!pat_f && (arg.empty() || ('-' != arg[0])))
+		{	pat = arg;
+			pat_f = true;
+		}
+		else if (pat_f && !arg.empty() && ('-' != arg[0]))	files.push_back(arg);
+		else
+		{	Usage();
+			return 1;
+		}
+	}
+	
+	if (!pat_f || files.empty() || (pat.find('\n') != string::npos))
+	{	Usage();
+		return 1;
+	}
+	
+	const LineFilter	filter(levels, threads);
+	
+	// a lone level is searched as its column text, then checked in place
+	if (pat.empty() && (1 == levels.size()))
+		pat = xsprintf("|%08x|", levels[0]);
+	
+	const size_t	window = n_threads * 4;
+	
+	vector<string>	texts(window);
+	vector<size_t>	counts(window);
+	int		res = 1;		// (like grep: 0 if any match)
+	
+	for (const string &fn : files)
+	{
+		mapped_file	file(fn);
+		
+		if (!file.ok())
+		{
+			::fprintf(stderr, "lxgrep: %s: couldn't open\n", fn.c_str());
+			res = 2;
+			continue;
+		}
+		
+		const string	prefix = (files.size() > 1) ? (fn + ":") : string{};
+		
+		// line-aligned chunks
+		vector<pair<size_t, size_t>>	chunks;
+		
+		for (size_t pos = 0; pos < file.size(); )
+		{
+			size_t	end = std::min(pos + CHUNK_BYTES, file.size());
+			
+			const char	*nl = (const char*) ::memchr(file.data() + end - 1, '\n', file.size() - end + 1);
+			
+			end = nl ? ((nl - file.data()) + 1) : file.size();
+			
+			chunks.emplace_back(pos, end - pos);
+			pos = end;
+		}
+		
+		size_t	n_matches = 0;
+		
+		// windows of a few chunks per thread, output stays in file order
+		for (size_t base = 0; base < chunks.size(); base += window)
+		{
+			const size_t	n = std::min(window, chunks.size() - base);
+			
+			atomic<size_t>	next{0};
+			
+			auto	worker = [&]()
+			{
+				for (size_t i = next++; i < n; i = next++)
+				{
+					texts[i].clear();
+					counts[i] = ScanChunk(file.data() + chunks[base + i].first, chunks[base + i].second, pat, filter, prefix, count_f, texts[i]);
+				}
+			};
+			
+			vector<thread>	workers;
+			
+			for (size_t t = 1; t < std::min(n_threads, n); t++)	workers.emplace_back(worker);
+			
+			worker();
+			
+			for (auto &th : workers)	th.join();
+			
+			for (size_t i = 0; i < n; i++)
+			{
+				::fwrite(texts[i].data(), 1, texts[i].size(), stdout);
+				
+				n_matches += counts[i];
+			}
+		}
+		
+		if (count_f)	::printf("%s%zu\n", prefix.c_str(), n_matches);
+		
+		if (n_matches && (2 != res))	res = 0;
+	}
+	
+	return res;
+}
+
+// nada mas
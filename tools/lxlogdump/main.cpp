@@ -0,0 +1,126 @@
+// lxlogdump - renders binary logs (LogSlot::CreateBinary) to the text file layout
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "lx/ulog.h"
+#include "lx/binlog.h"
+
+using namespace std;
+using namespace LX;
+
+static
+void	Usage(void)
+{
+	::fprintf(stderr,
+		"usage: lxlogdump [options] <file>\n"
+		"  -s             stamp with seconds (Y/M/D H:M:S)\n"
+		"  -m             stamp with millisecs (default)\n"
+		"  -u             stamp with microsecs\n"
+		"  -z             UTC stamps\n"
+		"  -l             hex level column\n"
+		"  -e <secs>      min elapsed secs for separator line (default 3.0)\n"
+		"  -j <threads>   decoding threads (default: all cores)\n");
+}
+
+int	main(int argc, char *argv[])
+{
+	STAMP_FORMAT	fmt = STAMP_FORMAT::MILLISEC;
+	bool		utc_f = false, level_f = false;
+	double		min_elap_secs = 3.0;
+	size_t		n_threads = std::max(1u, thread::hardware_concurrency());
+	string		fn;
+	
+	for (int i = 1; i < argc; i++)
+	{
+		const string	arg(argv[i]);
+		
+		if ("-s" == arg)		fmt = STAMP_FORMAT::SECOND;
+		else if ("-m" == arg)		fmt = STAMP_FORMAT::MILLISEC;
+		else if ("-u" == arg)		fmt = STAMP_FORMAT::MICROSEC;
+		else if ("-z" == arg)		utc_f = true;
+		else if ("-l" == arg)		level_f = true;
+		else if (("-e" == arg) && ((i + 1) < argc))	min_elap_secs = Soft_stod(argv[++i], min_elap_secs);
+		else if (("-j" == arg) && ((i + 1) < argc))	n_threads = std::max(1, Soft_stoi(argv[++i], 1));
+		else if (fn.empty() && ('-' != arg[0]))		fn = arg;
+		else
+		{	Usage();
+			return 1;
+		}
+	}
+	
+	if (fn.empty())
+	{	Usage();
+		return 1;
+	}
+	
+	if (utc_f)	fmt = fmt | STAMP_FORMAT::UTC;
+	if (level_f)	fmt = fmt | STAMP_FORMAT::LEVEL;
+	
+	BinLogReader	reader(fn);
+	
+	if (!reader.Scan())
+	{
+		::fprintf(stderr, "lxlogdump: %s: %s\n", fn.c_str(), reader.Error().c_str());
+		return 1;
+	}
+	
+	const vector<binlog_block>	&blocks = reader.Blocks();
+	
+	// stream in windows of a few blocks per thread, output stays in file order
+	const size_t	window = n_threads * 4;
+	
+	vector<string>	bytes(window), texts(window);
+	vector<char>	ok_flags(window);
+	
+	for (size_t base = 0; base < blocks.size(); base += window)
+	{
+		const size_t	n = std::min(window, blocks.size() - base);
+		
+		for (size_t i = 0; i < n; i++)
+		{
+			if (!reader.ReadBlock(blocks[base + i], bytes[i]))
+			{
+				::fprintf(stderr, "lxlogdump: %s: %s\n", fn.c_str(), reader.Error().c_str());
+				return 1;
+			}
+		}
+		
+		atomic<size_t>	next{0};
+		
+		auto	worker = [&]()
+		{
+			for (size_t i = next++; i < n; i = next++)
+			{
+				texts[i].clear();
+				ok_flags[i] = reader.RenderBlock(blocks[base + i], bytes[i], fmt, min_elap_secs, texts[i]);
+			}
+		};
+		
+		vector<thread>	threads;
+		
+		for (size_t t = 1; t < std::min(n_threads, n); t++)	threads.emplace_back(worker);
+		
+		worker();
+		
+		for (auto &th : threads)	th.join();
+		
+		for (size_t i = 0; i < n; i++)
+		{
+			::fwrite(texts[i].data(), 1, texts[i].size(), stdout);
+			
+			if (!ok_flags[i])
+				::fprintf(stderr, "lxlogdump: %s: corrupt block at offset %zu\n", fn.c_str(), (size_t) blocks[base + i].m_Offset);
+		}
+	}
+	
+	return 0;
+}
+
+// nada mas
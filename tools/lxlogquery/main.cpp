@@ -0,0 +1,360 @@
+// lxlogquery - prints the lines of an indexed text log (LogSlot::CreateIndexed) in a time range and/or level set
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "lx/ulog.h"
+#include "lx/logindex.h"
+
+using namespace std;
+using namespace LX;
+
+static
+void	Usage(void)
+{
+	::fprintf(stderr,
+		"usage: lxlogquery [options] <file>\n"
+		"  -f <time>         from \"yyyy-mm-dd hh:mm[:ss[.fff]]\", or \"hh:mm[:ss[.fff]]\" on the log's first day\n"
+		"  -t <time>         to (inclusive, at the log's stamp precision)\n"
+		"  -l <tag>[,<tag>]  levels by name (e.g. LX_ERROR,WARNING) or 0x<hash>\n"
+		"  -c                print count of matching lines only\n"
+		"  -v                print blocks read / total on stderr\n");
+}
+
+	// local (or UTC) wall time, returns false if malformed
+
+static
+bool	ParseTime(const string &s, const bool utc_f, const int64_t day_of_us, int64_t &us)
+{
+	const time_t	day_secs = (time_t) (day_of_us / 1'000'000);
+	struct tm	tm_v{};
+	
+	#ifdef WIN32
+		utc_f ? ::gmtime_s(&tm_v, &day_secs) : ::localtime_s(&tm_v, &day_secs);
+	#else
+		utc_f ? ::gmtime_r(&day_secs, &tm_v) : ::localtime_r(&day_secs, &tm_v);
+	#endif
+	
+	int	y = 0, mo = 0, d = 0, h = 0, mi = 0;
+	double	secs = 0;
+	
+	if (::sscanf(s.c_str(), "%d-%d-%d %d:%d:%lf", &y, &mo, &d, &h, &mi, &secs) >= 5)
+	{
+		tm_v.tm_year = y - 1900;
+		tm_v.tm_mon = mo - 1;
+		tm_v.tm_mday = d;
+	}
+	else if (::sscanf(s.c_str(), "%d:%d:%lf", &h, &mi, &secs) < 2)
+		return false;
+	
+	tm_v.tm_hour = h;
+	tm_v.tm_min = mi;
+	tm_v.tm_sec = 0;
+	tm_v.tm_isdst = -1;
+	
+	#ifdef WIN32
+		const time_t	t = utc_f ? ::_mkgmtime(&tm_v) : ::mktime(&tm_v);
+	#else
+		const time_t	t = utc_f ? ::timegm(&tm_v) : ::mktime(&tm_v);
+	#endif
+	
+	if ((time_t) -1 == t)	return false;
+	
+	us = ((int64_t) t * 1'000'000) + (int64_t) (secs * 1'000'000 + 0.5);
+	return true;
+}
+
+	// calendar day of a stamp (local or UTC), as days since the epoch
+
+static
+int64_t	DayNumber(const int64_t us, const bool utc_f)
+{
+	const time_t	secs = (time_t) ((us >= 0) ? (us / 1'000'000) : -((-us + 999'999) / 1'000'000));
+	struct tm	tm_v{};
+	
+	#ifdef WIN32
+		utc_f ? ::gmtime_s(&tm_v, &secs) : ::localtime_s(&tm_v, &secs);
+	#else
+		utc_f ? ::gmtime_r(&secs, &tm_v) : ::localtime_r(&secs, &tm_v);
+	#endif
+	
+	struct tm	day_v{};
+	
+	day_v.tm_year = tm_v.tm_year;
+	day_v.tm_mon = tm_v.tm_mon;
+	day_v.tm_mday = tm_v.tm_mday;
+	
+	#ifdef WIN32
+		return (int64_t) ::_mkgmtime(&day_v) / 86'400;
+	#else
+		return (int64_t) ::timegm(&day_v) / 86'400;
+	#endif
+}
+
+static
+bool	ParseLevels(const string &s, vector<LogLevel> &levels)
+{
+	size_t	pos = 0;
+	
+	while (pos <= s.size())
+	{
+		size_t	end = s.find(',', pos);
+		if (string::npos == end)	end = s.size();
+		
+		const string	tag = s.substr(pos, end - pos);
+		
+		if (tag.empty())	return false;
+		
+		if (!tag.compare(0, 2, "0x"))
+			levels.push_back(Soft_stoul(tag.substr(2), 0, 16));
+		else	levels.push_back(log_hash(tag.c_str()));
+		
+		pos = end + 1;
+	}
+	
+	return true;
+}
+
+	// lines are "[----\n]<stamp>|<hex level>| msg", multi-line messages' continuation lines follow their head's fate
+	// stamps without a date ("hh:mm:ss...") are compared along with a day number: a block starts on
+	// the day of its min stamp (the unindexed tail on that of the last indexed stamp), and moves to
+	// the next day wherever the time of day goes back by more than 12 hours
+
+class LineFilter
+{
+	static constexpr int	DAY_SECS = 86'400;
+	
+public:
+	// unbounded ends are INT64_MIN / INT64_MAX
+	LineFilter(const STAMP_FORMAT fmt, const int64_t from_us, const int64_t to_us, const vector<LogLevel> &levels, const int64_t tail_us)
+		: m_FromUS(from_us), m_ToUS(to_us), m_Levels(levels),
+		m_UTCFlag(!!(fmt & STAMP_FORMAT::UTC)),
+		m_DayFlag(!(fmt & STAMP_FORMAT::YMD) && !!(fmt & STAMP_FORMAT::HMS)),
+		m_TailUS(tail_us), m_FromDay(0), m_ToDay(0), m_Day(0), m_PrevSecs(0),
+		m_NextOffset(0), m_LastMatch(false)
+	{
+		char	buff[STAMP_MAX_CHARS];
+		
+		m_StampLen = timestamp_t::Now().str(buff, sizeof(buff), fmt);
+		
+		if (INT64_MIN != from_us)	m_FromText.assign(buff, timestamp_t::FromUS(from_us).str(buff, sizeof(buff), fmt));
+		if (INT64_MAX != to_us)		m_ToText.assign(buff, timestamp_t::FromUS(to_us).str(buff, sizeof(buff), fmt));
+		
+		if (m_DayFlag && (INT64_MIN != from_us))	m_FromDay = DayNumber(from_us, m_UTCFlag);
+		if (m_DayFlag && (INT64_MAX != to_us))		m_ToDay = DayNumber(to_us, m_UTCFlag);
+	}
+	
+	// calls fn(line, len) on matches (incl. '\n')
+	template<typename _Fn>
+	void	Block(const logindex_block &blk, const string &bytes, _Fn fn)
+	{
+		// stamps only compared in blocks straddling the range
+		const bool	check_time = (blk.m_MinUS < m_FromUS) || (blk.m_MaxUS > m_ToUS);
+		
+		// (a skipped block ended the previous message)
+		if (blk.m_Offset != m_NextOffset)	m_LastMatch = false;
+		
+		if (m_DayFlag)
+		{
+			if (INT64_MIN != blk.m_MinUS)		StartDay(blk.m_MinUS);
+			else if (blk.m_Offset != m_NextOffset)	StartDay(m_TailUS);		// (else carries on from the previous tail chunk)
+		}
+		
+		m_NextOffset = blk.m_Offset + blk.m_Bytes;
+		
+		for (size_t pos = 0; pos < bytes.size(); )
+		{
+			size_t	end = bytes.find('\n', pos);
+			end = (string::npos == end) ? bytes.size() : (end + 1);
+			
+			const char	*line = bytes.data() + pos;
+			const size_t	len = end - pos;
+			
+			pos = end;
+			
+			if (IsSeparator(line, len))	continue;
+			
+			if (IsHead(line, len))
+			{
+				if (m_DayFlag)	TrackDay(line);
+				
+				m_LastMatch = MatchLevel(line + m_StampLen + 1) && (!check_time || MatchTime(line));
+			}
+			
+			if (m_LastMatch)	fn(line, len);
+		}
+	}
+
+private:
+
+	static
+	bool	IsSeparator(const char *p, const size_t n)
+	{
+		size_t	i = 0;
+		
+		while ((i < n) && ('-' == p[i]))	i++;
+		
+		return (i > 0) && ((i == n) || ('\n' == p[i]));
+	}
+	
+	bool	IsHead(const char *p, const size_t n) const
+	{
+		return (n >= (m_StampLen + 10)) && ('|' == p[m_StampLen]) && ('|' == p[m_StampLen + 9]);
+	}
+	
+	bool	MatchLevel(const char *hex) const
+	{
+		if (m_Levels.empty())	return true;
+		
+		const LogLevel	lvl = Soft_stoul(string(hex, 8), 0, 16);
+		
+		return m_Levels.end() != std::find(m_Levels.begin(), m_Levels.end(), lvl);
+	}
+	
+	static
+	int	SecsOfDay(const char *hms)
+	{
+		auto	two = [&](const size_t i){return ((hms[i] - '0') * 10) + (hms[i + 1] - '0');};
+		
+		return (two(0) * 3600) + (two(3) * 60) + two(6);
+	}
+	
+	void	StartDay(const int64_t us)
+	{
+		char	buff[STAMP_MAX_CHARS];
+		
+		timestamp_t::FromUS(us).str(buff, sizeof(buff), m_UTCFlag ? (STAMP_FORMAT::HMS | STAMP_FORMAT::UTC) : STAMP_FORMAT::HMS);
+		
+		m_Day = DayNumber(us, m_UTCFlag);
+		m_PrevSecs = SecsOfDay(buff);
+	}
+	
+	// (small steps back are just threads' stamps landing out of order)
+	void	TrackDay(const char *p)
+	{
+		const int	secs = SecsOfDay(p);
+		
+		if ((secs + (DAY_SECS / 2)) < m_PrevSecs)	m_Day++;
+		
+		m_PrevSecs = secs;
+	}
+	
+	// same format & width, so text order is time order (after the day number if the format has no date)
+	bool	MatchTime(const char *p) const
+	{
+		const bool	from_ok = m_FromText.empty() || (m_Day > m_FromDay) || ((m_Day == m_FromDay) && (::memcmp(p, m_FromText.data(), m_StampLen) >= 0));
+		const bool	to_ok = m_ToText.empty() || (m_Day < m_ToDay) || ((m_Day == m_ToDay) && (::memcmp(p, m_ToText.data(), m_StampLen) <= 0));
+		
+		return from_ok && to_ok;
+	}
+	
+	const int64_t		m_FromUS, m_ToUS;
+	const vector<LogLevel>	&m_Levels;
+	const bool		m_UTCFlag;
+	const bool		m_DayFlag;		// stamps have no date
+	const int64_t		m_TailUS;		// last indexed stamp
+	size_t			m_StampLen;
+	string			m_FromText, m_ToText;
+	int64_t			m_FromDay, m_ToDay;
+	int64_t			m_Day;			// of the current line
+	int			m_PrevSecs;		// time of day of the previous line
+	uint64_t		m_NextOffset;
+	bool			m_LastMatch;
+};
+
+int	main(int argc, char *argv[])
+{
+	string		from_s, to_s, fn;
+	vector<LogLevel>	levels;
+	bool		count_f = false, verbose_f = false;
+	
+	for (int i = 1; i < argc; i++)
+	{
+		const string	arg(argv[i]);
+		
+		if (("-f" == arg) && ((i + 1) < argc))		from_s = argv[++i];
+		else if (("-t" == arg) && ((i + 1) < argc))	to_s = argv[++i];
+		else if (("-l" == arg) && ((i + 1) < argc) && ParseLevels(argv[++i], levels))	{}
+		else if ("-c" == arg)		count_f = true;
+		else if ("-v" == arg)		verbose_f = true;
+		else if (fn.empty() && ('-' != arg[0]))		fn = arg;
+		else
+		{	Usage();
+			return 1;
+		}
+	}
+	
+	if (fn.empty())
+	{	Usage();
+		return 1;
+	}
+	
+	LogIndexReader	reader(fn);
+	
+	if (!reader.Load())
+	{
+		::fprintf(stderr, "lxlogquery: %s: %s\n", fn.c_str(), reader.Error().c_str());
+		return 1;
+	}
+	
+	// stamp text w/o the level column
+	const STAMP_FORMAT	fmt = reader.Format() & ~STAMP_FORMAT::LEVEL;
+	const bool		utc_f = !!(fmt & STAMP_FORMAT::UTC);
+	
+	// time-of-day only bounds fall on the first indexed day
+	const int64_t	day_us = reader.IndexedBlocks() ? reader.Blocks()[0].m_MinUS : timestamp_t::Now().GetUSecs();
+	int64_t		from_us = INT64_MIN, to_us = INT64_MAX;
+	
+	if ((!from_s.empty() && !ParseTime(from_s, utc_f, day_us, from_us)) || (!to_s.empty() && !ParseTime(to_s, utc_f, day_us, to_us)))
+	{
+		::fprintf(stderr, "lxlogquery: bad time, expected \"yyyy-mm-dd hh:mm[:ss[.fff]]\" or \"hh:mm[:ss[.fff]]\"\n");
+		return 1;
+	}
+	
+	// "to" covers its whole last stamp tick
+	if (INT64_MAX != to_us)
+		to_us += (!!(fmt & STAMP_FORMAT::US) ? 1 : !!(fmt & STAMP_FORMAT::MS) ? 1'000 : 1'000'000) - 1;
+	
+	vector<logindex_block>	blocks;
+	
+	reader.Query(from_us, to_us, levels, blocks);
+	
+	// (the unindexed tail goes on from the last indexed stamp)
+	const int64_t	tail_us = reader.IndexedBlocks() ? reader.Blocks()[reader.IndexedBlocks() - 1].m_MaxUS : day_us;
+	
+	LineFilter	filter(fmt, from_us, to_us, levels, tail_us);
+	
+	string		bytes;
+	size_t		n_matches = 0;
+	
+	for (const auto &blk : blocks)
+	{
+		if (!reader.ReadBlock(blk, bytes))
+		{
+			::fprintf(stderr, "lxlogquery: %s: %s\n", fn.c_str(), reader.Error().c_str());
+			return 1;
+		}
+		
+		filter.Block(blk, bytes, [&](const char *line, const size_t len)
+		{
+			n_matches++;
+			
+			if (!count_f)	::fwrite(line, 1, len, stdout);
+		});
+	}
+	
+	if (count_f)	::printf("%zu\n", n_matches);
+	
+	if (verbose_f)
+		::fprintf(stderr, "lxlogquery: read %zu of %zu blocks (%zu unindexed)\n", blocks.size(), reader.Blocks().size(), reader.Blocks().size() - reader.IndexedBlocks());
+	
+	return 0;
+}
+
+// nada mas